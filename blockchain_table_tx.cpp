@@ -1,6 +1,14 @@
 #include "blockchain_table_tx.h"
 
-blockchain_table_tx::blockchain_table_tx(THD* thd, int hton_slot, int prepare_immediately) {
+blockchain_table_tx::blockchain_table_tx(THD* thd, int hton_slot, const Table_name& table_name,
+                                         int prepare_immediately,
+                                         std::unique_ptr<Tx_arena>* arena_slot,
+                                         Tx_flush_config flush_config, size_t memory_budget) {
+  // Reuse arena of previous transaction of the session
+  arena = *arena_slot ? std::move(*arena_slot) : std::make_unique<Tx_arena>();
+  this->arena_slot = arena_slot;
+
+
   // Get or create transaction ID
   auto ha_data_ptr = thd->get_ha_data(hton_slot);
   auto ha_data = static_cast<ha_data_map *>(ha_data_ptr->ha_ptr);
@@ -8,6 +16,12 @@ blockchain_table_tx::blockchain_table_tx(THD* thd, int hton_slot, int prepare_im
   table_scan_data_filled = false;
   pending_remove_activated = false;
   commit_prepare_success = true;
+  commit_prepare_submitted = false;
+  journaled = false;
+  this->table_name = table_name;
+  flushed_count = 0;
+  this->flush_config = flush_config;
+  this->memory_budget = memory_budget;
   this->prepare_immediately = prepare_immediately;
 
   // Check if a table_tx object already exists: if yes, copy transaction ID
@@ -27,91 +41,335 @@ blockchain_table_tx::blockchain_table_tx(THD* thd, int hton_slot, int prepare_im
 
 blockchain_table_tx::~blockchain_table_tx() {
   wait_for_commit_prepare_workers();
-  commit_prepare_workers.clear();
+
+  // Release all payloads at once and return arena for the next transaction
+  clear_operations();
+  pending_remove_operations = std::queue<Remove_op>();
+  statement_operations.clear();
+  arena->reset();
+  *arena_slot = std::move(arena);
 
   // log transaction id for debug purposes
   // std::cout << "Deleting TX: " + get_printable_id() + "\n";
 }
 
-void blockchain_table_tx::add_put(Put_op putOp, Connector* connector) {
+int blockchain_table_tx::add_put(Put_op putOp, Connector* connector) {
   if(prepare_immediately) {
-    // Send to blockchain tx buffer
-    auto thread = std::thread([&, putOp, connector]() {
-      Byte_data key(putOp.key.data->data(), putOp.key.data->size());
-      Byte_data value(putOp.value.data->data(), putOp.value.data->size());
-      int rc = connector->put(&key, &value, id);
-
-      std::lock_guard<std::mutex> lock(commit_prepare_success_mtx);
-      commit_prepare_success = std::min(commit_prepare_success, rc == 0);
-    });
-    commit_prepare_workers.emplace_back(std::move(thread));
+    // Sent to blockchain tx buffer at the end of the statement
+    commit_prepare_submitted = true;
+    statement_operations.push_back(Batch_op{putOp.key, putOp.value, false});
   }
 
   apply_put_op_to_cache(putOp);
-  put_operations.emplace_back(std::move(putOp));
+  if(table_scan_data.out_of_memory() ||
+     !log_operation(Batch_op{std::move(putOp.key), std::move(putOp.value), false})) {
+    return HA_ERR_OUT_OF_MEM;
+  }
+
+  if(flush_config.rows > 0 && operation_count() - flushed_count >= (size_t) flush_config.rows) {
+    flush(connector);
+  }
+  check_memory_budget(connector);
+  return 0;
 }
 
-void blockchain_table_tx::add_remove(Remove_op removeOp, bool pending, Connector* connector) {
+int blockchain_table_tx::add_remove(Remove_op removeOp, bool pending, Connector* connector) {
   if(pending && pending_remove_activated) {
     pending_remove_operations.push(std::move(removeOp));
   } else {
 
     if(prepare_immediately) {
-      // Send to blockchain tx buffer
-      auto thread = std::thread([&, removeOp, connector]() {
-        Byte_data bd(removeOp.key.data->data(), removeOp.key.data->size());
-        int rc = connector->remove(&bd, id);
-
-        std::lock_guard<std::mutex> lock(commit_prepare_success_mtx);
-        commit_prepare_success = std::min(commit_prepare_success, rc == 0);
-      });
-      commit_prepare_workers.emplace_back(std::move(thread));
+      // Sent to blockchain tx buffer at the end of the statement
+      commit_prepare_submitted = true;
+      statement_operations.push_back(Batch_op{removeOp.key, Managed_byte_data(), true});
     }
 
     apply_remove_op_to_cache(removeOp);
-    remove_operations.emplace_back(std::move(removeOp));
+    if(!log_operation(Batch_op{std::move(removeOp.key), Managed_byte_data(), true})) {
+      return HA_ERR_OUT_OF_MEM;
+    }
+
+    if(flush_config.rows > 0 && operation_count() - flushed_count >= (size_t) flush_config.rows) {
+      flush(connector);
+    }
+    check_memory_budget(connector);
   }
+
+  return 0;
+}
+
+/*
+ * Only the final state of a key is sent to the blockchain: a later put or remove of the
+ * same key replaces the logged operation (last writer wins), unless it was already sent.
+ * Returns false if the index can not grow (operation not logged).
+ */
+bool blockchain_table_tx::log_operation(Batch_op&& op) {
+  auto key = op.key.data->data();
+  auto key_size = op.key.data->size();
+
+  auto entry = operation_index.find(key, key_size);
+  if(entry != nullptr) {
+    size_t position;
+    memcpy(&position, entry->value, sizeof(position));
+
+    if(position >= flushed_count) {
+      if(position < spilled_operations.size()) {
+        // Overwrite in the spill file
+        Spilled_op& spilled = spilled_operations[position];
+        spilled.remove = op.remove;
+        spilled.data.value_size = op.remove ? 0 : std::min(op.value.data->size(), (size_t) TX_CACHE_SLOT_SIZE);
+        memset(spilled.data.value, 0, TX_CACHE_SLOT_SIZE);
+        if(!op.remove) memcpy(spilled.data.value, op.value.data->data(), spilled.data.value_size);
+      } else {
+        operations[position - spilled_operations.size()] = std::move(op);
+      }
+      return true;
+    }
+  }
+
+  size_t position = operation_count();
+  operation_index.put(key, key_size, reinterpret_cast<const uint8_t*>(&position), sizeof(position));
+  if(operation_index.out_of_memory()) {
+    return false;
+  }
+  operations.push_back(std::move(op));
+  return true;
+}
+
+size_t blockchain_table_tx::operation_count() {
+  return spilled_operations.size() + operations.size();
 }
 
-std::vector<Put_op>* blockchain_table_tx::get_put_operations() {
-  return &put_operations;
+/*
+ * Operation at position, spilled operations are read back from the spill file
+ */
+Batch_op blockchain_table_tx::operation_at(size_t position) {
+  if(position >= spilled_operations.size()) {
+    return operations[position - spilled_operations.size()];
+  }
+
+  const Spilled_op& spilled = spilled_operations[position];
+  Batch_op op{Managed_byte_data(spilled.data.key_size), Managed_byte_data(), spilled.remove};
+  memcpy(op.key.data->data(), spilled.data.key, spilled.data.key_size);
+  if(!spilled.remove) {
+    op.value = Managed_byte_data(spilled.data.value_size);
+    memcpy(op.value.data->data(), spilled.data.value, spilled.data.value_size);
+  }
+
+  return op;
+}
+
+std::vector<Batch_op>* blockchain_table_tx::get_operations() {
+  return &operations;
+}
+
+/*
+ * Own change of key in this transaction (overlay over the rows of the blockchain): returns
+ * false if the key was not changed. value points into the operation log (valid until the next change)
+ */
+bool blockchain_table_tx::find_operation(const byte* key, size_t key_size, bool& remove, Byte_data& value) {
+  auto entry = operation_index.find(key, key_size);
+  if(entry == nullptr) {
+    return false;
+  }
+
+  size_t position;
+  memcpy(&position, entry->value, sizeof(position));
+
+  if(position < spilled_operations.size()) {
+    Spilled_op& spilled = spilled_operations[position];
+    remove = spilled.remove;
+    value = Byte_data(spilled.data.value, spilled.data.value_size);
+  } else {
+    auto& op = operations[position - spilled_operations.size()];
+    remove = op.remove;
+    value = remove ? Byte_data(nullptr, 0) : Byte_data(op.value.data->data(), op.value.data->size());
+  }
+
+  return true;
+}
+
+void blockchain_table_tx::clear_operations() {
+  operations.clear();
+  spilled_operations.clear();
+  flushed_count = 0;
+  operation_index.clear();
+}
+
+size_t blockchain_table_tx::memory_usage() {
+  return (operations.size() + statement_operations.size()) * TX_OP_MEMORY_ESTIMATE +
+         table_scan_data.memory_usage() + operation_index.memory_usage();
+}
+
+void blockchain_table_tx::check_memory_budget(Connector* connector) {
+  if(memory_budget > 0 && memory_usage() > memory_budget) {
+    spill(connector);
+  }
 }
 
-std::vector<Remove_op>* blockchain_table_tx::get_remove_operations() {
-  return &remove_operations;
+/*
+ * Transaction exceeds bc_tx_memory_budget: moves the operation log, its index and the
+ * transaction cache into spill files. prepare_immediately: operations of the current statement
+ * are sent early (in more than one batch). Payloads of later operations are allocated on the
+ * heap (and freed when they are spilled), so the arena does not grow beyond the budget.
+ */
+void blockchain_table_tx::spill(Connector* connector) {
+  if(!spilled_operations.is_spilled()) {
+    std::cout << "[BLOCKCHAIN] Transaction exceeds memory budget, spilling to disk" << std::endl;
+  }
+
+  if(!statement_operations.empty()) {
+    auto batch = std::make_shared<std::vector<Batch_op>>(std::move(statement_operations));
+    statement_operations.clear();
+    submit_batch(std::move(batch), connector);
+  }
+
+  // reserved up front, so the operations below are moved completely or not at all
+  if(!spilled_operations.spill() || !operation_index.spill() || !table_scan_data.spill() ||
+     !spilled_operations.reserve(spilled_operations.size() + operations.size())) {
+    std::cerr << "[BLOCKCHAIN] Spilling failed, transaction stays in memory" << std::endl;
+    memory_budget = 0;
+    return;
+  }
+
+  for(auto& op : operations) {
+    Spilled_op spilled{};
+    spilled.remove = op.remove;
+    spilled.data.key_size = std::min(op.key.data->size(), (size_t) TX_CACHE_SLOT_SIZE);
+    memcpy(spilled.data.key, op.key.data->data(), spilled.data.key_size);
+    if(!op.remove) {
+      spilled.data.value_size = std::min(op.value.data->size(), (size_t) TX_CACHE_SLOT_SIZE);
+      memcpy(spilled.data.value, op.value.data->data(), spilled.data.value_size);
+    }
+    spilled_operations.push_back(spilled);
+  }
+
+  // positions stay the same, only where the operations are kept changes
+  operations = std::vector<Batch_op>();
 }
 
 void blockchain_table_tx::apply_put_op_to_cache(Put_op & putOp) {
-  table_scan_data[putOp.key] = putOp.value; // increments counter of internal shared_ptr
+  table_scan_data.put(putOp.key.data->data(), putOp.key.data->size(),
+                      putOp.value.data->data(), putOp.value.data->size());
 }
 
 void blockchain_table_tx::apply_remove_op_to_cache(Remove_op & removeOp) {
-  table_scan_data.erase(removeOp.key);
+  table_scan_data.erase(removeOp.key.data->data(), removeOp.key.data->size());
 }
 
-void blockchain_table_tx::reapply_pending_operations() {
-  for(auto& putOp : put_operations) {
-    apply_put_op_to_cache(putOp);
+int blockchain_table_tx::reapply_pending_operations() {
+  for(auto& op : spilled_operations) {
+    if(op.remove) {
+      table_scan_data.erase(op.data.key, op.data.key_size);
+    } else {
+      table_scan_data.put(op.data.key, op.data.key_size, op.data.value, op.data.value_size);
+    }
   }
 
-  for(auto& removeOp : remove_operations) {
-    apply_remove_op_to_cache(removeOp);
+  for(auto& op : operations) {
+    if(op.remove) {
+      table_scan_data.erase(op.key.data->data(), op.key.data->size());
+    } else {
+      table_scan_data.put(op.key.data->data(), op.key.data->size(), op.value.data->data(), op.value.data->size());
+    }
   }
+
+  return table_scan_data.out_of_memory() ? HA_ERR_OUT_OF_MEM : 0;
 }
 
-void blockchain_table_tx::apply_pending_remove_ops(Connector* connector) {
+int blockchain_table_tx::apply_pending_remove_ops(Connector* connector) {
+  int rc = 0;
   while (!pending_remove_operations.empty()) {
     auto pending_remove = std::move(pending_remove_operations.front());
     pending_remove_operations.pop();
 
-    add_remove(pending_remove, false, connector);  // adds it to full list and applies to cache
+    // adds it to full list and applies to cache
+    rc = std::max(rc, add_remove(pending_remove, false, connector));
   }
+
+  return rc;
+}
+
+/*
+ * prepare_immediately: sends the operations of the statement in one batch to the blockchain
+ * tx buffer. Sending happens in the worker pool, mining is awaited at commit
+ * (Connector::wait_for_submitted) --> overlaps with the next statements.
+ */
+void blockchain_table_tx::end_statement(Connector* connector) {
+  if(statement_operations.empty()) {
+    return;
+  }
+
+  auto batch = std::make_shared<std::vector<Batch_op>>(std::move(statement_operations));
+  statement_operations.clear();
+  submit_batch(std::move(batch), connector);
+}
+
+/*
+ * Without prepare_immediately: sends the operations buffered since the last flush to the
+ * blockchain tx buffer (in the worker pool, mining is awaited at commit). Afterwards the
+ * transaction has to be committed via the tx buffer.
+ * Sent in chunks of TX_FLUSH_CHUNK_OPS, so spilled operations are streamed back from the
+ * spill file instead of being loaded at once.
+ */
+void blockchain_table_tx::flush(Connector* connector) {
+  if(prepare_immediately) {
+    return;
+  }
+
+  while(flushed_count < operation_count()) {
+    size_t end = std::min(operation_count(), flushed_count + TX_FLUSH_CHUNK_OPS);
+
+    auto batch = std::make_shared<std::vector<Batch_op>>();
+    batch->reserve(end - flushed_count);
+    for(size_t i = flushed_count; i < end; i++) {
+      batch->push_back(operation_at(i));
+    }
+    flushed_count = end;
+
+    submit_batch(std::move(batch), connector);
+  }
+}
+
+void blockchain_table_tx::submit_batch(std::shared_ptr<std::vector<Batch_op>> batch, Connector* connector) {
+  // Batches are sent in order
+  commit_prepare_tasks.wait();
+
+  // Before the first operation reaches the tx buffer: record it for recovery after a crash
+  if(!journaled) {
+    if(Commit_journal::get().prepare(id, table_name) != 0) {
+      std::lock_guard<std::mutex> lock(commit_prepare_success_mtx);
+      commit_prepare_success = false; // commit fails, operations are not sent
+      return;
+    }
+    journaled = true;
+  }
+
+  // blocks while the queue of the worker pool is full
+  Worker_pool::get().submit(commit_prepare_tasks, [this, batch, connector]() {
+    int rc = connector->submit_apply_batch(batch.get(), id);
+
+    std::lock_guard<std::mutex> lock(commit_prepare_success_mtx);
+    commit_prepare_success = std::min(commit_prepare_success, rc == 0);
+  });
+}
+
+bool blockchain_table_tx::has_flushed() {
+  return flushed_count > 0;
+}
+
+bool blockchain_table_tx::has_spilled() {
+  return spilled_operations.is_spilled();
 }
 
 boost::uuids::uuid blockchain_table_tx::get_ID() {
   return id;
 }
 
+Tx_arena* blockchain_table_tx::get_arena() {
+  return has_spilled() ? nullptr : arena.get();
+}
+
 std::string blockchain_table_tx::get_printable_id() {
   std::stringstream ss;
   for(int i=0; i<16; i++) {
@@ -122,17 +380,16 @@ std::string blockchain_table_tx::get_printable_id() {
 }
 
 bool blockchain_table_tx::wait_for_commit_prepare_workers() {
-  for(auto& thread : commit_prepare_workers) {
-    if(thread.joinable()) thread.join();
-  }
+  commit_prepare_tasks.wait();
 
+  std::lock_guard<std::mutex> lock(commit_prepare_success_mtx);
   return commit_prepare_success;
 }
 
 bool blockchain_table_tx::is_read_only() {
   if(prepare_immediately) {
-    return commit_prepare_workers.empty(); // If no prepare workers, no put or remove operation exists
+    return !commit_prepare_submitted; // If nothing was sent, no put or remove operation exists
   } else {
-    return get_put_operations()->empty() && get_remove_operations()->empty();
+    return operation_count() == 0;
   }
 }
@@ -7,6 +7,9 @@
 #include <iomanip>
 #include "types.h"
 #include "connector.h"
+#include "worker_pool.h"
+#include "commit_journal.h"
+#include "tx_spill.h"
 
 #include <sql/sql_class.h>
 
@@ -14,22 +17,66 @@
  * The table_scan_data is also used during UPDATES and DELETES to find matching tuples.
  * We need to ensure that the table_scan_data remains usable during one table scan even if
  * UPDATES and DELETES happen in place. For UPDATES this is not a problem, since
- * std::unordered_map is not re-hashed. But DELETES would invalid the iterator,
+ * values are overwritten in place. But DELETES would move entries (see Tx_cache),
  * so they have to be deferred to the end of the table scan (rnd_end()).
  */
 
+/*
+ * Threshold for sending buffered operations to the blockchain tx buffer before commit
+ * (without prepare_immediately), 0: off
+ */
+struct Tx_flush_config {
+  int rows;  // number of buffered operations
+};
+
+#define TX_FLUSH_CHUNK_OPS 1024 // operations per batch when sending buffered operations
+
+/*
+ * Estimated memory per operation held in memory (Batch_op, payloads with shared_ptr control
+ * blocks), used for the check against bc_tx_memory_budget
+ */
+#define TX_OP_MEMORY_ESTIMATE 256
+
+/*
+ * Operation moved into the spill file (key and value are max. 32 bytes, see Tx_cache)
+ */
+struct Spilled_op {
+  Tx_cache::Entry data;
+  bool remove;
+};
+
 // Transaction table for one table!
 class blockchain_table_tx {
  private:
-  std::vector<Put_op> put_operations;
-  std::vector<Remove_op> remove_operations;
+  std::unique_ptr<Tx_arena> arena; // backs payloads of operations, declared first (destroyed last)
+  std::unique_ptr<Tx_arena>* arena_slot; // arena is returned there at the end of the transaction
+  /*
+   * Last put or remove per key, in order of first change of the key. Positions [0, n) are in
+   * spilled_operations (n = its size), the following ones in operations.
+   */
+  Spill_vector<Spilled_op> spilled_operations;
+  std::vector<Batch_op> operations;
+  size_t flushed_count; // positions [0, flushed_count) are already sent to the blockchain tx buffer
+  Tx_flush_config flush_config;
+  Tx_cache operation_index; // position of key (value: size_t)
+  size_t memory_budget; // bytes, 0: unlimited (bc_tx_memory_budget)
   std::queue<Remove_op> pending_remove_operations;
   TXID id;
-  std::vector<std::thread> commit_prepare_workers;
+  Table_name table_name;
+  bool journaled; // prepare record of the table is in the commit journal
+  Worker_pool::Task_group commit_prepare_tasks;
+  bool commit_prepare_submitted; // at least one operation was sent with prepare_immediately
+  std::vector<Batch_op> statement_operations; // prepare_immediately: operations of current statement
   std::mutex commit_prepare_success_mtx;
   bool commit_prepare_success;
   int prepare_immediately;
 
+  bool log_operation(Batch_op&& op);
+  size_t operation_count();
+  Batch_op operation_at(size_t position);
+  size_t memory_usage();
+  void spill(Connector* connector);
+  void submit_batch(std::shared_ptr<std::vector<Batch_op>> batch, Connector* connector);
   void apply_put_op_to_cache(Put_op& op);
   void apply_remove_op_to_cache(Remove_op& op);
   std::string get_printable_id();
@@ -42,16 +89,26 @@ class blockchain_table_tx {
   bool table_scan_data_filled;
   bool pending_remove_activated;
 
-  blockchain_table_tx(THD* thd, int hton_slot, int prepare_immediately);
+  blockchain_table_tx(THD* thd, int hton_slot, const Table_name& table_name, int prepare_immediately, std::unique_ptr<Tx_arena>* arena_slot,
+                      Tx_flush_config flush_config = {0}, size_t memory_budget = 0);
   ~blockchain_table_tx();
 
-  void add_put(Put_op putOp, Connector* connector);
-  void add_remove(Remove_op removeOp, bool pending, Connector* connector);
-  std::vector<Put_op>* get_put_operations();
-  std::vector<Remove_op>* get_remove_operations();
-  void reapply_pending_operations();
-  void apply_pending_remove_ops(Connector* connector);
+  // Return 0 on success, HA_ERR_OUT_OF_MEM if the transaction state can not grow (memory or
+  // spill file exhausted): the operation is lost, the transaction has to be rolled back
+  int add_put(Put_op putOp, Connector* connector);
+  int add_remove(Remove_op removeOp, bool pending, Connector* connector);
+  std::vector<Batch_op>* get_operations(); // only if nothing was spilled
+  bool find_operation(const byte* key, size_t key_size, bool& remove, Byte_data& value);
+  void clear_operations();
+  int reapply_pending_operations();
+  void check_memory_budget(Connector* connector);
+  int apply_pending_remove_ops(Connector* connector);
+  void end_statement(Connector* connector);
+  void flush(Connector* connector);
+  bool has_flushed();
+  bool has_spilled();
   TXID get_ID();
+  Tx_arena* get_arena();
   bool wait_for_commit_prepare_workers();
   bool is_read_only();
 
@@ -0,0 +1,150 @@
+#include "commit_journal.h"
+
+#include <algorithm>
+#include <cstring>
+
+#define COMMIT_RECORD_PREPARE 'P' // transaction id, table
+#define COMMIT_RECORD_COMMIT 'C'  // transaction id, tables
+#define COMMIT_RECORD_ABORT 'A'   // transaction id
+#define COMMIT_RECORD_DONE 'D'    // transaction id
+
+Commit_journal& Commit_journal::get() {
+  static Commit_journal journal;
+  return journal;
+}
+
+/*
+ * Payload of a record (see Journal_file): transaction id (16 bytes) followed by the table
+ * names, each terminated by '\0'
+ */
+static std::string encode_payload(const TXID& id, const std::vector<Table_name>& tables) {
+  std::string payload(reinterpret_cast<const char*>(id.data), 16);
+  for(auto& table : tables) {
+    payload.append(table);
+    payload.push_back('\0');
+  }
+
+  return payload;
+}
+
+std::vector<Commit_journal::Entry> Commit_journal::open(const std::string& path) {
+  std::lock_guard<std::mutex> lock(mtx);
+
+  file.open(path, [this](char type, const char* payload, uint32_t length, uint64_t offset) {
+    if(length < 16) {
+      return false; // not written by this journal
+    }
+
+    TXID id;
+    memcpy(id.data, payload, 16);
+
+    std::vector<Table_name> tables;
+    size_t begin = 16;
+    for(size_t i = begin; i < length; i++) {
+      if(payload[i] == '\0') {
+        tables.emplace_back(payload + begin, i - begin);
+        begin = i + 1;
+      }
+    }
+
+    if(type == COMMIT_RECORD_DONE) {
+      open_entries.erase(id);
+    } else {
+      auto& entry = open_entries[id];
+      entry.id = id;
+      for(auto& table : tables) {
+        if(std::find(entry.tables.begin(), entry.tables.end(), table) == entry.tables.end()) {
+          entry.tables.push_back(table);
+        }
+      }
+      if(type == COMMIT_RECORD_COMMIT) {
+        entry.committing = true;
+      } else if(type == COMMIT_RECORD_ABORT) {
+        entry.committing = false;
+      }
+    }
+    return true;
+  });
+
+  // Start with the open entries only (drops done ones)
+  rewrite();
+
+  std::vector<Entry> entries;
+  for(auto& entry : open_entries) {
+    entries.push_back(entry.second);
+  }
+  return entries;
+}
+
+/*
+ * Replaces the journal by one with a record per open entry. Until the rename, the old
+ * journal remains valid (same open entries).
+ */
+void Commit_journal::rewrite() {
+  std::string journal;
+  for(auto& entry : open_entries) {
+    journal.append(Journal_file::encode_record(entry.second.committing ? COMMIT_RECORD_COMMIT : COMMIT_RECORD_PREPARE,
+                                               encode_payload(entry.first, entry.second.tables)));
+  }
+  file.rewrite(journal);
+}
+
+int Commit_journal::write_record(char type, const TXID& id, const std::vector<Table_name>& tables) {
+  return file.append(type, encode_payload(id, tables));
+}
+
+int Commit_journal::prepare(const TXID& id, const Table_name& table) {
+  std::lock_guard<std::mutex> lock(mtx);
+  if(write_record(COMMIT_RECORD_PREPARE, id, {table}) != 0) {
+    return 1;
+  }
+
+  auto& entry = open_entries[id];
+  entry.id = id;
+  entry.tables.push_back(table);
+  return 0;
+}
+
+int Commit_journal::commit(const TXID& id, const std::vector<Table_name>& tables) {
+  std::lock_guard<std::mutex> lock(mtx);
+  if(write_record(COMMIT_RECORD_COMMIT, id, tables) != 0) {
+    return 1;
+  }
+
+  auto& entry = open_entries[id];
+  entry.id = id;
+  entry.tables = tables;
+  entry.committing = true;
+  return 0;
+}
+
+int Commit_journal::abort(const TXID& id) {
+  std::lock_guard<std::mutex> lock(mtx);
+  if(write_record(COMMIT_RECORD_ABORT, id, {}) != 0) {
+    return 1;
+  }
+
+  open_entries[id].committing = false;
+  return 0;
+}
+
+int Commit_journal::done(const TXID& id) {
+  std::lock_guard<std::mutex> lock(mtx);
+  if(open_entries.find(id) == open_entries.end()) {
+    return 0; // nothing was sent to a tx buffer
+  }
+
+  if(write_record(COMMIT_RECORD_DONE, id, {}) != 0) {
+    return 1;
+  }
+  open_entries.erase(id);
+
+  // Keep the journal small: empty it when no commit is in flight, or rewrite it
+  if(open_entries.empty()) {
+    file.truncate();
+  } else if(file.size() > COMMIT_JOURNAL_MAX_SIZE) {
+    rewrite();
+  }
+
+  return 0;
+}
@@ -0,0 +1,56 @@
+#ifndef MYSQL_BLOCKCHAIN_COMMIT_JOURNAL_H
+#define MYSQL_BLOCKCHAIN_COMMIT_JOURNAL_H
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "journal_file.h"
+#include "types.h"
+
+#define COMMIT_JOURNAL_FILE "bc_commit.journal" // relative to data directory of the server
+#define COMMIT_JOURNAL_MAX_SIZE (1024 * 1024)   // rewritten with the open entries only if larger
+
+/*
+ * Local write-ahead journal of commits using the tx buffers of the store contracts.
+ * Records (fsynced) per transaction id:
+ *   prepare: a table sends operations to its tx buffer (before the first batch is sent)
+ *   commit:  commitAll is sent for the tables
+ *   abort:   commitAll failed, the tx buffers still have to be cleaned
+ *   done:    transaction is committed or its tx buffers are cleaned
+ * After a crash, open entries are finished (commitAll sent again, a no-op if it was mined)
+ * or cleaned, see ha_blockchain::recover_commits().
+ */
+class Commit_journal {
+ public:
+  struct Entry {
+    TXID id;
+    std::vector<Table_name> tables;
+    bool committing{false}; // commit record written
+  };
+
+  static Commit_journal& get();
+
+  /*
+   * Opens the journal and returns the entries of transactions that were not done
+   */
+  std::vector<Entry> open(const std::string& path);
+
+  // Return 0 on success, 1 on failure
+  int prepare(const TXID& id, const Table_name& table);
+  int commit(const TXID& id, const std::vector<Table_name>& tables);
+  int abort(const TXID& id);
+  int done(const TXID& id);
+
+ private:
+  std::mutex mtx;
+  Journal_file file{"commit journal"};
+  std::map<TXID, Entry> open_entries;
+
+  int write_record(char type, const TXID& id, const std::vector<Table_name>& tables);
+  void rewrite();
+};
+
+#endif  // MYSQL_BLOCKCHAIN_COMMIT_JOURNAL_H
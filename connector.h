@@ -6,6 +6,8 @@
 #include <vector>
 #include "types.h"
 
+#define APPLY_NOT_SINGLE_TRANSACTION 2 // apply_single_transaction: does not fit, nothing was sent
+
 /*
  * Interface definition to be used by storage engine to communicate with
  * concrete blockchain technology handler, like Ethereum
@@ -41,6 +43,48 @@ class Connector {
    */
   virtual int remove_batch(std::vector<Remove_op> * data, TXID txID = {{0}}) = 0;
 
+  /*
+   * Like put_batch, but does not wait until the operations are persisted,
+   * see wait_for_submitted()
+   * returns 0 on success, 1 on failure
+   */
+  virtual int submit_put_batch(std::vector<Put_op> * data, TXID txID = {{0}}) = 0;
+
+  /*
+   * Like remove_batch, but does not wait until the operations are persisted,
+   * see wait_for_submitted()
+   * returns 0 on success, 1 on failure
+   */
+  virtual int submit_remove_batch(std::vector<Remove_op> * data, TXID txID = {{0}}) = 0;
+
+  /*
+   * Apply puts and removes in the given order.
+   * Without txID, the operations are persisted directly (in several blockchain transactions
+   * if they do not fit into one, see apply_single_transaction())
+   * returns 0 on success, 1 on failure
+   */
+  virtual int apply_batch(std::vector<Batch_op> * data, TXID txID = {{0}}) = 0;
+
+  /*
+   * Like apply_batch, but does not wait until the operations are persisted,
+   * see wait_for_submitted()
+   * returns 0 on success, 1 on failure
+   */
+  virtual int submit_apply_batch(std::vector<Batch_op> * data, TXID txID = {{0}}) = 0;
+
+  /*
+   * Like apply_batch without txID, but persists all operations atomically in one blockchain
+   * transaction, never split
+   * returns 0 on success, 1 on failure, APPLY_NOT_SINGLE_TRANSACTION if they do not fit
+   */
+  virtual int apply_single_transaction(std::vector<Batch_op> * data) = 0;
+
+  /*
+   * Wait until all submitted operations are persisted, in order of submission
+   * returns 0 on success, 1 on failure
+   */
+  virtual int wait_for_submitted() = 0;
+
   /*
    * Do a table scan, puts tuples in provided vector object (key+value concatenated)
    * --> faster than getting each KV-pair in an own transaction
@@ -53,6 +53,14 @@ static std::string numeric_to_hex(T num, int size=64) {
   return ss.str();
 }
 
+static std::string to_hex_quantity(uint64 num) {
+  return "0x" + numeric_to_hex(num, 0); // no leading zeros
+}
+
+static uint64 parse_hex_quantity(const std::string& s) {
+  return strtoull(s.substr(2).c_str(), nullptr, 16); // remove 0x
+}
+
 static std::vector<std::string> split(const std::string& str, int split_length) {
     ulong num_substrings = str.length() / split_length;
     std::vector<std::string> ret;
@@ -79,6 +87,11 @@ static std::string parse_params_to_json(const RPC_params& params) {
     if (!params.to.empty()) els.push_back(R"("to":")" + params.to + "\"");
     if (!params.gas.empty()) els.push_back(R"("gas":")" + params.gas + "\"");
     if (!params.gas_price.empty()) els.push_back(R"("gasPrice":")" + params.gas_price + "\"");
+    if (!params.max_fee_per_gas.empty()) els.push_back(R"("maxFeePerGas":")" + params.max_fee_per_gas + "\"");
+    if (!params.max_priority_fee_per_gas.empty()) {
+      els.push_back(R"("maxPriorityFeePerGas":")" + params.max_priority_fee_per_gas + "\"");
+    }
+    if (!params.access_list.empty()) els.push_back(R"("accessList":)" + params.access_list);
     if (params.nonce > 0) {
       std::stringstream ss;
       ss << "0x";
@@ -101,11 +114,17 @@ static std::string parse_params_to_json(const RPC_params& params) {
 Ethereum::Ethereum(std::string connection_string,
                    std::string store_contract_address,
                    std::string from_address,
-                   int max_waiting_time) {
+                   int max_waiting_time,
+                   Fee_config fee_config,
+                   int layout,
+                   uint32_t table_id) {
     _store_contract_address = std::move(store_contract_address);
     _from_address = std::move(from_address);
     _connection_string = std::move(connection_string);
     this->max_waiting_time = max_waiting_time * 1000; // convert to ms
+    this->fee_config = fee_config;
+    this->layout = layout;
+    this->table_id = table_id;
 
     curl = curl_easy_init();
     curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
@@ -147,7 +166,7 @@ int Ethereum::get(Byte_data* key, unsigned char* buf, int value_size) {
 
   RPC_params params;
   params.method = "eth_call";
-  params.data = "0x8eaa6ac0" + hexKey;
+  params.data = store_function("0x8eaa6ac0") + hexKey;
   params.quantity_tag = "latest";
   // log("Data: " + params.data, "Get");
 
@@ -194,9 +213,9 @@ int Ethereum::put(Byte_data* key, Byte_data* value, TXID txid) {
     params.method = "eth_sendTransaction";
 
     if(txid.is_nil()) {
-      params.data = "0x4c667080" + hex_key + hex_val;
+      params.data = store_function("0x4c667080") + hex_key + hex_val;
     } else {
-      params.data = "0x3c58dd03" + hex_key + hex_val + txid_val;
+      params.data = store_function("0x3c58dd03") + hex_key + hex_val + txid_val;
     }
 
     // log("Data: " + params.data, "Put");
@@ -215,59 +234,75 @@ int Ethereum::put(Byte_data* key, Byte_data* value, TXID txid) {
 }
 
 int Ethereum::put_batch(std::vector<Put_op>* data, TXID txid) {
-  auto size = data->size();
+  int rc = submit_put_batch(data, txid);
+  return std::max(rc, wait_for_submitted());
+}
+
+/*
+ * Appends length prefix and data (without trailing zero bytes, the contract pads with zeros).
+ * flags are set in the length prefix (length is max. 32)
+ */
+static void append_packed(std::stringstream& ss, Managed_byte_data& data, byte flags = 0) {
+  size_t length = data.data->size();
+  while(length > 0 && data.data->at(length - 1) == 0) {
+    length--;
+  }
+
+  auto bd = Byte_data(data.data->data(), length);
+  ss << numeric_to_hex(length | flags, 2);
+  ss << byte_array_to_hex(&bd, length);
+}
+
+/*
+ * ABI encoding of arguments (bytes, [bytes16 txID]) for the given hex string.
+ * head: size of arguments in front of them (table id of multi-table store)
+ */
+static std::string encode_bytes_argument(const std::string& hex, TXID txid, size_t head = 0) {
+  size_t size = hex.size() / 2;
 
   std::stringstream data_string;
   if(txid.is_nil()) {
-    data_string << numeric_to_hex(64);
-    data_string << numeric_to_hex(96 + 32 * size);
+    data_string << numeric_to_hex(head + 32);
   } else {
-    data_string << numeric_to_hex(96);
-    data_string << numeric_to_hex(128 + 32 * size);
+    data_string << numeric_to_hex(head + 64);
 
     Byte_data bdTxid(txid.data, 16);
     data_string << byte_array_to_hex(&bdTxid);
   }
 
-  // All keys
-  data_string << numeric_to_hex(size); // number of keys
-  for(ulong i=0; i<size; i++) {
-    auto& put_op = data->at(i);
-    auto bd = Byte_data(put_op.key.data->data(), put_op.key.data->size());
-    data_string << byte_array_to_hex(&bd);
-  }
-
-  // All values
-  data_string << numeric_to_hex(size); // number of values
-  for(ulong i=0; i<size; i++) {
-    auto& put_op = data->at(i);
-    auto bd = Byte_data(put_op.value.data->data(), put_op.value.data->size());
-    data_string << byte_array_to_hex(&bd);
-  }
-
-  RPC_params params;
-  params.method = "eth_sendTransaction";
+  data_string << numeric_to_hex(size); // length in bytes
+  data_string << hex;
+  data_string << std::string((32 - size % 32) % 32 * 2, '0'); // pad to multiple of 32 bytes
 
-  if(txid.is_nil()) {
-    params.data = "0x9b36675c" + data_string.str();
-  } else {
-    params.data = "0x0238a793" + data_string.str();
-  }
+  return data_string.str();
+}
 
-  // log("Data: " + params.data, "PutBatch");
+int Ethereum::submit_put_batch(std::vector<Put_op>* data, TXID txid) {
+  // Packed encoding: for each operation key length (1 byte), key, value length (1 byte), value
+  // --> short keys and values are not padded to 32 bytes as in ABI encoded bytes32[]
+  size_t head = store_head_size();
+  auto encode_chunk = [&data, &txid, head](size_t begin, size_t end) {
+    std::stringstream packed;
+    for(ulong i=begin; i<end; i++) {
+      auto& put_op = data->at(i);
+      append_packed(packed, put_op.key);
+      append_packed(packed, put_op.value);
+    }
 
-  const std::string response = call(params, true);
-  // log("Response: " + response, "PutBatch");
+    return encode_bytes_argument(packed.str(), txid, head);
+  };
 
+  auto key_at = [&data](size_t i) {
+    auto& key = data->at(i).key;
+    return Access_key{Byte_data(key.data->data(), key.data->size()), false};
+  };
 
-  if (response.find("error") == std::string::npos) {
-    log("success", "Put_batch");
-    return 0;
+  if(txid.is_nil()) {
+    return send_in_chunks("Put_batch", "0xac42e005", gas_per_put_op(), data->size(), encode_chunk,
+                          SIZE_MAX, key_at);
   } else {
-    log("Failed: " + response, "Put_batch");
-    return 1;
+    return send_in_chunks("Put_batch", "0x7c312dbf", GAS_PER_TX_BUFFER_OP, data->size(), encode_chunk);
   }
-
 }
 
 int Ethereum::remove(Byte_data *key, TXID txid) {
@@ -280,9 +315,9 @@ int Ethereum::remove(Byte_data *key, TXID txid) {
     params.method = "eth_sendTransaction";
 
     if(txid.is_nil()) {
-      params.data = "0x95bc2673" + hex_key;
+      params.data = store_function("0x95bc2673") + hex_key;
     } else {
-      params.data = "0x29a32c0a" + hex_key + txid_val;
+      params.data = store_function("0x29a32c0a") + hex_key + txid_val;
     }
     // log("Data: " + params.data, "Remove");
 
@@ -300,13 +335,80 @@ int Ethereum::remove(Byte_data *key, TXID txid) {
 }
 
 int Ethereum::remove_batch(std::vector<Remove_op> * data, TXID txid) {
-  auto size = data->size();
+  int rc = submit_remove_batch(data, txid);
+  return std::max(rc, wait_for_submitted());
+}
+
+int Ethereum::submit_remove_batch(std::vector<Remove_op> * data, TXID txid) {
+  size_t head = store_head_size();
+  auto encode_chunk = [&data, &txid, head](size_t begin, size_t end) {
+    std::stringstream data_string;
+    if(txid.is_nil()) {
+      data_string << numeric_to_hex(head + 32);
+    } else {
+      data_string << numeric_to_hex(head + 64);
+
+      Byte_data bdTxid(txid.data, 16);
+      data_string << byte_array_to_hex(&bdTxid);
+    }
+
+    // All keys
+    data_string << numeric_to_hex(end - begin); // number of keys
+    for(ulong i=begin; i<end; i++) {
+      auto& remove_op = data->at(i);
+      auto bd = Byte_data(remove_op.key.data->data(), remove_op.key.data->size());
+      data_string << byte_array_to_hex(&bd);
+    }
+
+    return data_string.str();
+  };
+
+  auto key_at = [&data](size_t i) {
+    auto& key = data->at(i).key;
+    return Access_key{Byte_data(key.data->data(), key.data->size()), true};
+  };
+
+  if(txid.is_nil()) {
+    return send_in_chunks("remove_batch", "0x2d9bb756", GAS_PER_REMOVE_OP, data->size(), encode_chunk,
+                          SIZE_MAX, key_at);
+  } else {
+    return send_in_chunks("remove_batch", "0x702de045", GAS_PER_TX_BUFFER_OP, data->size(), encode_chunk);
+  }
+}
+
+int Ethereum::apply_batch(std::vector<Batch_op> * data, TXID txid) {
+  int rc = submit_apply_batch(data, txid);
+  return std::max(rc, wait_for_submitted());
+}
+
+/*
+ * ABI encoding of the arguments of applyBatch for operations [begin, end):
+ * keys, values (zero for removes), delete bitmap and, if set, txID.
+ * head: size of arguments in front of them (table id of multi-table store)
+ */
+static std::string encode_apply_batch(std::vector<Batch_op> * data, size_t begin, size_t end, TXID txid,
+                                      size_t head = 0) {
+  auto size = end - begin;
+
+  // Bit i of delete bitmap marks operation i as remove
+  std::vector<byte> delete_bitmap(32, 0);
+  for(ulong i=begin; i<end; i++) {
+    if(data->at(i).remove) {
+      size_t bit = i - begin;
+      delete_bitmap[31 - bit / 8] |= (byte) (1 << (bit % 8));
+    }
+  }
 
   std::stringstream data_string;
+  Byte_data bd_bitmap(delete_bitmap.data(), 32);
   if(txid.is_nil()) {
-    data_string << numeric_to_hex(32);
+    data_string << numeric_to_hex(head + 96);
+    data_string << numeric_to_hex(head + 128 + 32 * size);
+    data_string << byte_array_to_hex(&bd_bitmap);
   } else {
-    data_string << numeric_to_hex(64);
+    data_string << numeric_to_hex(head + 128);
+    data_string << numeric_to_hex(head + 160 + 32 * size);
+    data_string << byte_array_to_hex(&bd_bitmap);
 
     Byte_data bdTxid(txid.data, 16);
     data_string << byte_array_to_hex(&bdTxid);
@@ -314,33 +416,360 @@ int Ethereum::remove_batch(std::vector<Remove_op> * data, TXID txid) {
 
   // All keys
   data_string << numeric_to_hex(size); // number of keys
-  for(ulong i=0; i<size; i++) {
-    auto& remove_op = data->at(i);
-    auto bd = Byte_data(remove_op.key.data->data(), remove_op.key.data->size());
+  for(ulong i=begin; i<end; i++) {
+    auto& op = data->at(i);
+    auto bd = Byte_data(op.key.data->data(), op.key.data->size());
     data_string << byte_array_to_hex(&bd);
   }
 
-  RPC_params params;
-  params.method = "eth_sendTransaction";
+  // All values (zero for removes)
+  data_string << numeric_to_hex(size); // number of values
+  for(ulong i=begin; i<end; i++) {
+    auto& op = data->at(i);
+    auto bd = op.remove ? Byte_data(nullptr, 0) : Byte_data(op.value.data->data(), op.value.data->size());
+    data_string << byte_array_to_hex(&bd);
+  }
+
+  return data_string.str();
+}
+
+int Ethereum::submit_apply_batch(std::vector<Batch_op> * data, TXID txid) {
+  return submit_apply_batch(data, txid, true);
+}
+
+int Ethereum::submit_apply_batch(std::vector<Batch_op> * data, TXID txid, bool split) {
+  size_t head = store_head_size();
+  auto encode_chunk = [&data, &txid, head](size_t begin, size_t end) {
+    return encode_apply_batch(data, begin, end, txid, head);
+  };
+
+  auto key_at = [&data](size_t i) {
+    auto& op = data->at(i);
+    return Access_key{Byte_data(op.key.data->data(), op.key.data->size()), op.remove};
+  };
 
   if(txid.is_nil()) {
-    params.data = "0x2d9bb756" + data_string.str();
+    return send_in_chunks("apply_batch", "0x528d092e", gas_per_put_op(), data->size(),
+                          encode_chunk, APPLY_BATCH_MAX_OPS, key_at, split);
   } else {
-    params.data = "0x702de045" + data_string.str();
+    return send_in_chunks("apply_batch", "0xfce5533c", GAS_PER_TX_BUFFER_OP, data->size(),
+                          encode_chunk, APPLY_BATCH_MAX_OPS, nullptr, split);
+  }
+}
+
+int Ethereum::apply_single_transaction(std::vector<Batch_op> * data) {
+  int rc = submit_apply_batch(data, {{0}}, false);
+  if(rc == APPLY_NOT_SINGLE_TRANSACTION) {
+    return rc;
   }
+  return std::max(rc, wait_for_submitted());
+}
 
-  // log("Data: " + params.data, "removeBatch");
+/*
+ * Splits a batch of count operations into chunks that fit into the current block gas limit.
+ * All chunks are sent back to back (consecutive nonces, so the order is kept) without
+ * waiting for mining results, see wait_for_submitted().
+ */
+int Ethereum::send_in_chunks(const std::string& method_name, const std::string& selector,
+                             uint64 gas_per_op, size_t count,
+                             const std::function<std::string(size_t, size_t)>& encode_chunk,
+                             size_t max_chunk_size,
+                             const std::function<Access_key(size_t)>& key_at,
+                             bool split) {
+  const std::string function = store_function(selector);
+  const std::string gas_key = gas_model_key(function.substr(0, 10));
+  size_t chunk_size = std::min(max_chunk_size, max_ops_per_transaction(gas_model.gas_per_op(gas_key, gas_per_op)));
+  size_t sent = 0;
+
+  if(!split && count > chunk_size) {
+    std::stringstream msg;
+    msg << count << " operations do not fit into one transaction (max. " << chunk_size << ")";
+    log(msg.str(), method_name);
+    return APPLY_NOT_SINGLE_TRANSACTION;
+  }
 
-  const std::string response = call(params, true);
-  // log("Response: " + response, "removeBatch");
+  for(size_t begin = 0; begin < count; begin += chunk_size) {
+    size_t end = std::min(begin + chunk_size, count);
 
-  if (response.find("error") == std::string::npos) {
-    log("success", "remove_batch");
+    RPC_params params;
+    params.method = "eth_sendTransaction";
+    params.data = function + encode_chunk(begin, end);
+    params.op_count = end - begin;
+    params.gas_per_op = gas_per_op;
+    params.to = _store_contract_address;
+    params.from = _from_address;
+    if(use_access_lists && key_at) {
+      std::vector<Access_key> keys;
+      for(size_t i = begin; i < end; i++) {
+        keys.push_back(key_at(i));
+      }
+      params.access_list = build_access_list(keys);
+    }
+    params.gas = to_hex_quantity(estimate_gas(params));
+    // log("Data: " + params.data, method_name);
+
+    Pending_transaction transaction;
+    const std::string response = call(params, true, false, &transaction);
+    // log("Response: " + response, method_name);
+
+    if (response.find("error") != std::string::npos) {
+      log("Failed: " + response, method_name);
+      return 1; // already sent chunks are still awaited by wait_for_submitted()
+    }
+
+    std::lock_guard<std::mutex> lock(submitted_transactions_mtx);
+    submitted_transactions.push_back(std::move(transaction));
+    sent++;
+  }
+
+  std::stringstream msg;
+  msg << "Sent " << count << " operations in " << sent << " transactions";
+  log(msg.str(), method_name);
+  return 0;
+}
+
+int Ethereum::wait_for_submitted() {
+  std::vector<Pending_transaction> transactions;
+  {
+    std::lock_guard<std::mutex> lock(submitted_transactions_mtx);
+    transactions.swap(submitted_transactions);
+  }
+
+  if(transactions.empty()) {
+    return 0;
+  }
+
+  if(check_mining_results(std::move(transactions))) {
+    log("success", "waitForSubmitted");
     return 0;
   } else {
-    log("Failed: " + response, "remove_batch");
+    log("Failed: transactions were not mined successfully", "waitForSubmitted");
+    return 1;
+  }
+}
+
+size_t Ethereum::max_ops_per_transaction(uint64 gas_per_op) {
+  auto gas_limit = (uint64) (get_block_gas_limit() * BLOCK_GAS_LIMIT_USAGE);
+  if(gas_limit < TX_BASE_GAS + gas_per_op) {
     return 1;
   }
+
+  return (gas_limit - TX_BASE_GAS) / gas_per_op;
+}
+
+static std::string slot_to_string(const uint8_t* slot) {
+  Byte_data bd((byte*) slot, 32);
+  return "\"0x" + byte_array_to_hex(&bd) + "\"";
+}
+
+static void uint_to_word(uint64 num, uint8_t* word) {
+  memset(word, 0, 32);
+  for(int i = 31; i >= 0 && num > 0; i--, num >>= 8) {
+    word[i] = (uint8_t) num;
+  }
+}
+
+/*
+ * Location of a mapping entry: keccak256(key . slot), bytes32 keys are padded right
+ */
+static void mapping_location(const uint8_t* key, size_t key_size, const uint8_t* slot, uint8_t* out) {
+  uint8_t preimage[64] = {0};
+  memcpy(preimage, key, std::min(key_size, (size_t) 32));
+  memcpy(preimage + 32, slot, 32);
+  keccak_256(preimage, 64, out);
+}
+
+/*
+ * Storage slot of a mapping entry: keccak256(key . slot) + offset
+ */
+static std::string mapping_slot(const Byte_data& key, uint slot, uint offset = 0) {
+  uint8_t slot_word[32];
+  uint_to_word(slot, slot_word);
+
+  uint8_t hash[32];
+  mapping_location(key.data, key.data_size, slot_word, hash);
+
+  for(int i = 31; i >= 0 && offset > 0; i--) {
+    uint sum = hash[i] + (offset & 0xff);
+    hash[i] = (uint8_t) sum;
+    offset = (offset >> 8) + (sum >> 8);
+  }
+
+  return slot_to_string(hash);
+}
+
+/*
+ * Storage slot of a mapping entry in a mapping by table id (multi-table store)
+ */
+static std::string table_mapping_slot(uint32_t table_id, const Byte_data& key, uint slot) {
+  uint8_t slot_word[32];
+  uint8_t table_word[32];
+  uint_to_word(slot, slot_word);
+  uint_to_word(table_id, table_word);
+
+  uint8_t table_slot[32];
+  mapping_location(table_word, 32, slot_word, table_slot);
+
+  uint8_t hash[32];
+  mapping_location(key.data, key.data_size, table_slot, hash);
+  return slot_to_string(hash);
+}
+
+/*
+ * EIP-2930 access list of the store contract with the slots certainly touched by direct (not
+ * buffered) operations on the given keys: puts always write the value slots of their key,
+ * removes always read the index of their key. Slots only touched for new or existing keys
+ * (keyList, index of puts, value slots of removes) are not included, a listed slot that is not
+ * accessed costs more than it saves.
+ * Empty if the list does not save gas (ACCESS_LIST_ADDRESS_GAS not covered by the slots).
+ */
+std::string Ethereum::build_access_list(const std::vector<Access_key>& keys) {
+  std::set<std::string> slots;
+
+  for(auto& access : keys) {
+    auto& key = access.key;
+    if(layout == STORE_LAYOUT_MULTI) {
+      slots.insert(table_mapping_slot(table_id, key, KVSTORE_MULTI_SLOT_ENTRIES));
+      if(!access.remove) slots.insert(table_mapping_slot(table_id, key, KVSTORE_MULTI_SLOT_DATA));
+    } else if(layout == STORE_LAYOUT_V2) {
+      slots.insert(mapping_slot(key, KVSTORE_V2_SLOT_ENTRIES));
+      if(!access.remove) slots.insert(mapping_slot(key, KVSTORE_V2_SLOT_DATA));
+    } else if(access.remove) {
+      slots.insert(mapping_slot(key, KVSTORE_SLOT_KEY_INDEX));
+    } else {
+      slots.insert(mapping_slot(key, KVSTORE_SLOT_DATA));
+      slots.insert(mapping_slot(key, KVSTORE_SLOT_DATA, 1));
+    }
+  }
+
+  if(slots.size() * ACCESS_LIST_SLOT_SAVING <= ACCESS_LIST_ADDRESS_GAS) {
+    return "";
+  }
+
+  return R"([{"address":")" + _store_contract_address + R"(","storageKeys":[)"
+         + boost::algorithm::join(slots, ",") + "]}]";
+}
+
+/*
+ * Access list computed by the node (eth_createAccessList), empty if not supported. Only used
+ * for calls of the commit contract: the node leaves out the called contract, so the list holds
+ * the store contracts it calls (each entry saves gas over a cold call and cold slots).
+ */
+std::string Ethereum::create_access_list(RPC_params& params) {
+  RPC_params list_params;
+  list_params.from = _from_address;
+  list_params.to = params.to;
+  list_params.data = params.data;
+  std::string json = parse_params_to_json(list_params);
+  std::string method = "eth_createAccessList";
+
+  const std::string response = call(json, method);
+
+  try {
+    auto json_response = nlohmann::json::parse(response);
+    auto& access_list = json_response.at("result").at("accessList");
+    return access_list.empty() ? "" : access_list.dump();
+  } catch (std::exception&) {
+    log("Can not parse eth_createAccessList response, sending without access list", "createAccessList");
+    return "";
+  }
+}
+
+uint64 Ethereum::gas_per_put_op() {
+  return layout == STORE_LAYOUT_V1 ? GAS_PER_PUT_OP : GAS_PER_PUT_OP_V2;
+}
+
+/*
+ * Store contracts with different layouts share selectors, but not their gas usage
+ * (selectors of the multi-table store are distinct anyway)
+ */
+std::string Ethereum::gas_model_key(const std::string& selector) {
+  return layout == STORE_LAYOUT_V2 ? "v2:" + selector : selector;
+}
+
+/*
+ * Selector of a store contract function, given by its KVStore selector. Functions of the
+ * multi-table store take the table id as additional first argument, which is appended.
+ */
+std::string Ethereum::store_function(const std::string& selector) {
+  if(layout != STORE_LAYOUT_MULTI) {
+    return selector;
+  }
+
+  static const std::unordered_map<std::string, std::string> multi_selectors = {
+      {"0x8eaa6ac0", "0x519b771a"}, // get
+      {"0x4c667080", "0x83966885"}, // put
+      {"0x3c58dd03", "0xb591e52c"}, // put (txId)
+      {"0xac42e005", "0x2c844e5c"}, // putBatchPacked
+      {"0x7c312dbf", "0x4b045551"}, // putBatchPacked (txId)
+      {"0x95bc2673", "0x25b36e26"}, // remove
+      {"0x29a32c0a", "0x4666b617"}, // remove (txId)
+      {"0x2d9bb756", "0x7ee81297"}, // removeBatch
+      {"0x702de045", "0x2f9908c2"}, // removeBatch (txId)
+      {"0x528d092e", "0x0e0b6123"}, // applyBatch
+      {"0xfce5533c", "0x47a331ab"}, // applyBatch (txId)
+      {"0xb3055e26", "0xe09ff0eb"}, // tableScan
+      {"0x93ec62c1", "0x1e1594ba"}  // clean
+  };
+
+  return multi_selectors.at(selector) + numeric_to_hex(table_id);
+}
+
+/*
+ * Size of ABI encoded arguments added by store_function(), needed for offsets of dynamic arguments
+ */
+size_t Ethereum::store_head_size() {
+  return layout == STORE_LAYOUT_MULTI ? 32 : 0;
+}
+
+uint64 Ethereum::get_block_gas_limit() {
+  std::string param = R"("latest", false)";
+  std::string method = "eth_getBlockByNumber";
+  const std::string response = call(param, method);
+
+  try {
+    auto json = nlohmann::json::parse(response);
+    return parse_hex_quantity(json["result"]["gasLimit"].get<std::string>());
+  } catch (std::exception&) {
+    log("Can not parse eth_getBlockByNumber response, using default gas limit", "getBlockGasLimit");
+    return TX_DEFAULT_GAS;
+  }
+}
+
+/*
+ * Returns gas limit for transaction: predicted by gas model if the caller knows an upper bound
+ * of gas per operation, otherwise (gas depends on contract state) based on eth_estimateGas
+ */
+uint64 Ethereum::estimate_gas(RPC_params& params) {
+  const std::string selector = gas_model_key(params.data.substr(0, 10));
+
+  if(params.op_count > 0 && params.gas_per_op > 0) {
+    return gas_model.predict(selector, params.op_count, params.gas_per_op);
+  }
+
+  RPC_params estimate_params;
+  estimate_params.from = params.from;
+  estimate_params.to = params.to;
+  estimate_params.data = params.data;
+  estimate_params.access_list = params.access_list;
+  std::string json = parse_params_to_json(estimate_params);
+  std::string method = "eth_estimateGas";
+
+  const std::string response = call(json, method);
+
+  try {
+    auto json_response = nlohmann::json::parse(response);
+    auto estimate = parse_hex_quantity(json_response["result"].get<std::string>());
+    if(params.op_count == 0) {
+      return (uint64) (estimate * GAS_SAFETY_MARGIN);
+    }
+
+    gas_model.observe_estimate(selector, params.op_count, estimate);
+    return (uint64) (estimate * GAS_SAFETY_MARGIN);
+  } catch (std::exception&) {
+    log("Can not parse eth_estimateGas response, using default gas: " + response, "estimateGas");
+    return TX_DEFAULT_GAS;
+  }
 }
 
 void Ethereum::table_scan_to_vec(std::vector<Managed_byte_data> &tuples,
@@ -378,25 +807,28 @@ void Ethereum::table_scan_to_map(tx_cache_t& tuples,
   }
 
   log("success", "table_scan_to_map");
+  tuples.reserve(tuples.size() + count);
+
+  key_length = std::min(key_length, (size_t) TX_CACHE_SLOT_SIZE);
+  value_length = std::min(value_length, (size_t) TX_CACHE_SLOT_SIZE);
+  byte key[TX_CACHE_SLOT_SIZE];
+  byte value[TX_CACHE_SLOT_SIZE];
 
   for (std::vector<int>::size_type i = 3; i < 3 + count; i++) {
     std::vector<int>::size_type valueIndex = i + count + 1;
 
-    auto key = Managed_byte_data(key_length);
-    auto value = Managed_byte_data(value_length);
-
-    parse_32byte_hex_string(results[i], key.data->data(), key_length);
-    parse_32byte_hex_string(results[valueIndex], value.data->data(), value_length);
+    parse_32byte_hex_string(results[i], key, key_length);
+    parse_32byte_hex_string(results[valueIndex], value, value_length);
 
     //IMPORTANT: Only insert if value does not exist yet --> ensure data is read only once (--> anomalies)
-    tuples.emplace(key, std::move(value));
+    tuples.insert(key, key_length, value, value_length);
   }
 }
 
 std::vector<std::string> Ethereum::table_scan_call() {
   RPC_params params;
   params.method = "eth_call";
-  params.data = "0xb3055e26";
+  params.data = store_function("0xb3055e26");
   params.quantity_tag = "latest";
 
   const std::string s = call(params, false);
@@ -431,46 +863,238 @@ int Ethereum::drop_table() {
   return 0;
 }
 
-std::string Ethereum::check_mining_result(std::string& transaction_ID) {
-  std::string response;
+std::string Ethereum::check_mining_result(Pending_transaction& transaction) {
+  if(!check_mining_results({transaction})) {
+    throw Transaction_confirmation_exception("Transaction was not mined successfully!", transaction.hashes.front());
+  }
+
+  return transaction.hashes.front();
+}
+
+/*
+ * Waits until all given transactions are mined, returns false if at least one was not
+ * mined in time or failed. Transactions pending for longer than fee_config.replace_after
+ * are replaced by a transaction with the same nonce and a higher fee.
+ */
+bool Ethereum::check_mining_results(std::vector<Pending_transaction> transactions, bool* timed_out) {
   size_t waited = 0;
+  bool success = true;
 
-  while((waited + MINING_CHECK_INTERVAL) < this->max_waiting_time) {
+  while(!transactions.empty() && (waited + MINING_CHECK_INTERVAL) < this->max_waiting_time) {
     std::this_thread::sleep_for (std::chrono::milliseconds (MINING_CHECK_INTERVAL));
-    std::string transactionParam = "\"" + transaction_ID + "\"";
-    std::string method = "eth_getTransactionByHash";
-    response = call(transactionParam, method);
+    waited += MINING_CHECK_INTERVAL;
+
+    // transactions are mined in nonce order: once one is pending, later ones are pending as well
+    bool pending = false;
+
+    for(auto it = transactions.begin(); it != transactions.end();) {
+      if(!pending) {
+        bool failed = false;
+        bool out_of_gas = false;
+        if(is_mined(*it, failed, out_of_gas)) {
+          // Retry once with eth_estimateGas, only if no later transaction is awaited (order)
+          if(failed && out_of_gas && !it->retried && transactions.size() == 1 && resend_with_estimate(*it, waited)) {
+            continue;
+          }
+
+          success = success && !failed;
+          it = transactions.erase(it);
+          continue;
+        }
+
+        pending = true;
+      }
+
+      size_t replace_after = fee_config.replace_after * 1000;
+      if(fee_config.policy != FEE_NODE_DEFAULT && waited - it->submitted_at >= replace_after) {
+        replace_transaction(*it, waited);
+      }
+
+      it++;
+    }
+  }
+
+  if(!transactions.empty()) {
+    std::stringstream msg;
+    msg << "Failed to get receipt of " << transactions.size() << " transactions after " << this->max_waiting_time << " ms";
+    log(msg.str());
+    if(timed_out != nullptr) *timed_out = true;
+    return false;
+  }
+
+  std::stringstream msg;
+  msg << "Mining took about " << waited << " ms";
+  log(msg.str(), "checkMiningResults");
+  return success;
+}
+
+/*
+ * Checks the receipts of all hashes of a transaction. Gas used by a mined transaction
+ * is fed back into the gas model.
+ */
+bool Ethereum::is_mined(Pending_transaction& transaction, bool& failed, bool& out_of_gas) {
+  for(auto& hash : transaction.hashes) {
+    std::string transactionParam = "\"" + hash + "\"";
+    std::string method = "eth_getTransactionReceipt";
+    auto response = call(transactionParam, method);
 
     try {
       nlohmann::json jsonResponse = nlohmann::json::parse(response);
+      auto& receipt = jsonResponse.at("result");
+
+      if(receipt.is_null()) {
+        continue;
+      }
 
-      if(!(jsonResponse.at("result").at("blockNumber").is_null())) {
-        std::stringstream msg;
-        msg << "Mining took about " << waited << " ms";
-        log(msg.str(), "checkMiningResult");
-        return response;
+      auto selector = gas_model_key(transaction.params.data.substr(0, 10));
+      auto gas_limit = parse_hex_quantity(transaction.params.gas);
+      auto gas_used = parse_hex_quantity(receipt.at("gasUsed").get<std::string>());
+      gas_model.observe_receipt(selector, transaction.params.op_count, gas_used);
+
+      if(receipt.contains("status") && receipt.at("status").get<std::string>() == "0x0") {
+        log("Transaction failed: " + hash, "checkMiningResults");
+        if(gas_used >= gas_limit) {
+          gas_model.observe_out_of_gas(selector, transaction.params.op_count, gas_limit);
+          out_of_gas = true;
+        }
+        failed = true;
       }
+
+      return true;
     } catch (nlohmann::detail::exception& ) {
-      log("Can't parse " + response, "checkMiningResult");
+      log("Can't parse " + response, "checkMiningResults");
       // continue, so try again
     }
+  }
 
-    waited += MINING_CHECK_INTERVAL;
+  return false;
+}
+
+/*
+ * Sends a transaction that ran out of gas again (new nonce), with a gas limit from eth_estimateGas
+ */
+bool Ethereum::resend_with_estimate(Pending_transaction& transaction, size_t waited) {
+  RPC_params params = transaction.params;
+  params.gas.clear();
+  params.gas_per_op = 0; // --> eth_estimateGas on current contract state
+
+  Pending_transaction sent;
+  const std::string response = call(params, true, false, &sent);
+  if(response.find("error") != std::string::npos) {
+    log("Retry after out of gas failed: " + response, "checkMiningResults");
+    return false;
   }
 
+  log("Out of gas, sent again with estimated gas: " + response, "checkMiningResults");
+  transaction = std::move(sent);
+  transaction.submitted_at = waited;
+  transaction.retried = true;
+  return true;
+}
 
-  std::stringstream msg;
-  msg << "Failed to get transaction block number after " << this->max_waiting_time << " ms";
-  log(msg.str());
+/*
+ * Re-submits a pending transaction with the same nonce and fees increased by
+ * fee_config.bump_percent (at least to the current network fees)
+ */
+void Ethereum::replace_transaction(Pending_transaction& transaction, size_t waited) {
+  auto& params = transaction.params;
+
+  RPC_params current_fees;
+  set_fees(current_fees);
+
+  auto bump = [this](const std::string& fee, const std::string& current_fee) {
+    uint64 bumped = parse_hex_quantity(fee) * (100 + fee_config.bump_percent) / 100;
+    uint64 current = current_fee.empty() ? 0 : parse_hex_quantity(current_fee);
+    return to_hex_quantity(std::max(bumped, current));
+  };
+
+  if(!params.gas_price.empty()) {
+    params.gas_price = bump(params.gas_price, current_fees.gas_price);
+  } else if(!params.max_fee_per_gas.empty()) {
+    params.max_priority_fee_per_gas = bump(params.max_priority_fee_per_gas, current_fees.max_priority_fee_per_gas);
+    params.max_fee_per_gas = bump(params.max_fee_per_gas, current_fees.max_fee_per_gas);
+  } else {
+    return; // fees unknown, can not be increased
+  }
+
+  // Fees stay bumped even if submission fails (e.g. still underpriced), so next try bumps further
+  transaction.submitted_at = waited;
 
-  throw Transaction_confirmation_exception("Transaction was not mined!", transaction_ID);
+  std::string json = parse_params_to_json(params);
+  std::string method = "eth_sendTransaction";
+
+  std::string response;
+  try {
+    response = call(json, method);
+  } catch (Transaction_nonce_exception&) {
+    // nonce already used: one of the submitted transactions got mined in the meantime
+    return;
+  }
+
+  if(response.find("error") != std::string::npos) {
+    log("Failed to replace " + transaction.hashes.back() + ": " + response, "replaceTransaction");
+    return;
+  }
+
+  log("Replaced " + transaction.hashes.back() + " with " + response, "replaceTransaction");
+  transaction.hashes.push_back(response);
+}
+
+/*
+ * Sets the fee fields of a transaction according to the fee policy
+ */
+void Ethereum::set_fees(RPC_params& params) {
+  if(fee_config.policy == FEE_EIP1559) {
+    std::stringstream param;
+    param << "\"" << to_hex_quantity(FEE_HISTORY_BLOCKS) << R"(", "latest", [)" << FEE_REWARD_PERCENTILE << "]";
+    std::string fee_history_param = param.str();
+    std::string method = "eth_feeHistory";
+    const std::string response = call(fee_history_param, method);
+
+    try {
+      auto json = nlohmann::json::parse(response);
+      auto& result = json.at("result");
+
+      // last entry is the base fee of the next block
+      uint64 base_fee = parse_hex_quantity(result.at("baseFeePerGas").back().get<std::string>());
+
+      uint64 priority_fee = 0;
+      for(auto& block_rewards : result.at("reward")) {
+        priority_fee = std::max(priority_fee, parse_hex_quantity(block_rewards.at(0).get<std::string>()));
+      }
+
+      // base fee rises by max. 12.5% per block, so twice the base fee stays valid for several blocks
+      params.max_priority_fee_per_gas = to_hex_quantity(priority_fee);
+      params.max_fee_per_gas = to_hex_quantity(2 * base_fee + priority_fee);
+      return;
+    } catch (std::exception&) {
+      log("Can not parse eth_feeHistory response, using eth_gasPrice: " + response, "setFees");
+    }
+  }
+
+  if(fee_config.policy != FEE_NODE_DEFAULT) {
+    std::string gas_price_param;
+    std::string method = "eth_gasPrice";
+    const std::string response = call(gas_price_param, method);
+
+    try {
+      auto json = nlohmann::json::parse(response);
+      params.gas_price = to_hex_quantity(parse_hex_quantity(json.at("result").get<std::string>()));
+    } catch (std::exception&) {
+      log("Can not parse eth_gasPrice response: " + response, "setFees");
+    }
+  }
 }
 
 
-std::string Ethereum::call(RPC_params params, bool set_gas) {
+std::string Ethereum::call(RPC_params params, bool set_gas, bool wait_for_mining,
+                           Pending_transaction* sent) {
   params.from = _from_address;
   if(params.to.empty()) params.to = _store_contract_address;
-  if(set_gas) params.gas = "0x7A120";
+  if(set_gas && params.gas.empty()) params.gas = to_hex_quantity(estimate_gas(params));
+
+  bool has_fees = !params.gas_price.empty() || !params.max_fee_per_gas.empty();
+  if(params.method == "eth_sendTransaction" && !has_fees) set_fees(params);
 
   // Increment nonce to indicate that Ethereum should not replace a currently
   // pending transaction, but add as new transaction
@@ -482,17 +1106,34 @@ std::string Ethereum::call(RPC_params params, bool set_gas) {
 
   std::string response;
   try {
-    return call(json, params.method);
+    response = call(json, params.method);
   } catch (Transaction_nonce_exception& ex) {
     // Retry, which will increase nonce
     log("Retrying ETH transaction with higher nonce", "Call");
-    return call(params, set_gas);
-  } catch (Transaction_confirmation_exception& ex) {
-    return "error: " + std::string(ex.what());
+    return call(params, set_gas, wait_for_mining, sent);
   }
-}
 
-std::string Ethereum::call(std::string& params, std::string& method) {
+  if(params.method != "eth_sendTransaction" || response.find("error") != std::string::npos) {
+    return response;
+  }
+
+  Pending_transaction transaction{{response}, params, 0};
+  if(!wait_for_mining) {
+    if(sent != nullptr) *sent = std::move(transaction);
+    return response;
+  }
+
+  try {
+    return check_mining_result(transaction);
+  } catch (Transaction_confirmation_exception& ex) {
+    return "error: " + std::string(ex.what());
+  }
+}
+
+/*
+ * For eth_sendTransaction, returns only the transaction hash (see check_mining_results())
+ */
+std::string Ethereum::call(std::string& params, std::string& method) {
   std::string read_buffer_call;
   const std::string post_data = R"({"jsonrpc":"2.0","id":1,"method":")" + method + R"(","params":[)" + params + "]}";
   // log("Body: " + postData, "Call");
@@ -529,8 +1170,7 @@ std::string Ethereum::call(std::string& params, std::string& method) {
           read_buffer = "error: " + errorMsg;
         }
       } else {
-        auto result = json_response["result"].get<std::string>();
-        read_buffer = check_mining_result(result);
+        read_buffer = json_response["result"].get<std::string>();
       }
     } catch (nlohmann::detail::exception& ) {
       read_buffer = "error: Can not parse response from eth_sendTransaction, so unable to check mining result";
@@ -549,7 +1189,8 @@ int Ethereum::clear_commit_prepare(boost::uuids::uuid tx_ID) {
 
   RPC_params params;
   params.method = "eth_sendTransaction";
-  params.data = "0x93ec62c1" + txidVal;
+  params.data = store_function("0x93ec62c1") + txidVal;
+  params.op_count = 0; // gas depends on number of buffered operations
   // log("Data: " + params.data, "clearCommitPrepare");
 
   const std::string response = call(params, true);
@@ -564,45 +1205,871 @@ int Ethereum::clear_commit_prepare(boost::uuids::uuid tx_ID) {
   }
 }
 
+static std::string encode_address(std::string address) {
+  if(boost::starts_with(address, "0x")) {
+    address = address.substr(2);  // remove "0x" at beginning of address
+  }
+
+  boost::to_lower(address);
+  std::stringstream ss;
+  ss << std::setw(64) << std::setfill('0') << address;
+  return ss.str();
+}
+
+/*
+ * Tables of a transaction must either all be stored in their own contracts (committed by
+ * commit contract) or all in the same multi-table store contract (which commits itself)
+ */
+bool Ethereum::is_atomic_commit_supported(const std::vector<Table_contract>& contracts) {
+  for(auto& contract : contracts) {
+    if(contract.layout == STORE_LAYOUT_ROLLUP && contracts.size() > 1) {
+      return false; // journal of a rollup table is committed on its own
+    }
+  }
+
+  bool multi = !contracts.empty() && contracts[0].layout == STORE_LAYOUT_MULTI;
+
+  for(auto& contract : contracts) {
+    bool same_store = contract.layout == STORE_LAYOUT_MULTI && contract.address == contracts[0].address;
+    if(multi != same_store) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/*
+ * ABI encoded array of table ids (multi-table store) or of store contract addresses
+ */
+static std::string encode_store_array(const std::vector<Table_contract>& contracts) {
+  std::stringstream ss;
+  ss << numeric_to_hex(contracts.size());
+  for(auto& contract : contracts) {
+    if(contract.layout == STORE_LAYOUT_MULTI) {
+      ss << numeric_to_hex(contract.table_id);
+    } else {
+      ss << encode_address(contract.address);
+    }
+  }
+
+  return ss.str();
+}
+
 int Ethereum::atomic_commit(std::string connection_string,
                            std::string from_address,
                            int max_waiting_time,
+                           Fee_config fee_config,
                            std::string commit_contract_address, TXID tx_ID,
-                           const std::vector<std::string>& addresses) {
+                           const std::vector<Table_contract>& contracts) {
+  if(contracts[0].layout == STORE_LAYOUT_ROLLUP) {
+    return Ethereum_rollup::commit_prepared(contracts[0], tx_ID);
+  }
+
   Ethereum ethInstance(std::move(connection_string), "",
-                       std::move(from_address), max_waiting_time);
+                       std::move(from_address), max_waiting_time, fee_config);
 
   Byte_data bdTxid(tx_ID.data, 16);
   std::string txidVal = byte_array_to_hex(&bdTxid, 32);
 
-  std::stringstream address_string;
-  address_string << std::setw(64) << std::setfill('0') << "40"; // some magic Ethereum number
-  address_string << std::setw(64) << std::setfill('0') << addresses.size();
-  for(auto address : addresses) {
-    if(boost::starts_with(address, "0x")) {
-      address = address.substr(2);  // remove "0x" at beginning of address
+  RPC_params params;
+  params.method = "eth_sendTransaction";
+  params.op_count = 0; // gas depends on number of buffered operations
+
+  if(contracts[0].layout == STORE_LAYOUT_MULTI) {
+    // commitAll(bytes16,uint32[]) of multi-table store
+    params.data = "0xdbc134d2" + txidVal + numeric_to_hex(64) + encode_store_array(contracts);
+    params.to = contracts[0].address;
+  } else {
+    // commitAll(bytes16,address[]) of commit contract
+    params.data = "0x334c1176" + txidVal + numeric_to_hex(64) + encode_store_array(contracts);
+    params.to = std::move(commit_contract_address);
+    if(use_access_lists) params.access_list = ethInstance.create_access_list(params);
+  }
+
+  Pending_transaction sent;
+  const std::string response = ethInstance.call(params, true, false, &sent);
+  if (response.find("error") != std::string::npos) {
+    log("Failed: " + response, "atomicCommit");
+    return 1; // not sent
+  }
+
+  bool timed_out = false;
+  bool mined = ethInstance.check_mining_results({sent}, &timed_out);
+  for(auto& contract : contracts) {
+    if(contract.layout == STORE_LAYOUT_LOG) {
+      Log_table_state::get(contract.address)->written = true; // Commit event is read by the next sync
+    }
+  }
+
+  if(mined) {
+    log("success", "atomicCommit");
+    return 0;
+  } else if(timed_out) {
+    log("Outcome unknown, not mined in time: " + response, "atomicCommit");
+    return ATOMIC_COMMIT_UNKNOWN;
+  } else {
+    log("Failed (reverted): " + response, "atomicCommit");
+    return 1;
+  }
+}
+
+int Ethereum::atomic_apply(std::string connection_string,
+                           std::string from_address,
+                           int max_waiting_time,
+                           Fee_config fee_config,
+                           std::string commit_contract_address,
+                           const std::vector<Table_contract>& contracts,
+                           const std::vector<std::vector<Batch_op>*>& operations) {
+  // Gas per operation of applyAll depends on the layout of the stores (V2 if any is V2)
+  int layout = contracts[0].layout;
+  for(auto& contract : contracts) {
+    if(contract.layout == STORE_LAYOUT_LOG || contract.layout == STORE_LAYOUT_ROLLUP) {
+      return APPLY_NOT_SINGLE_TRANSACTION; // log stores only support commit of buffered operations, rollup tables commit locally
+    }
+    if(contract.layout == STORE_LAYOUT_V2) {
+      layout = STORE_LAYOUT_V2;
+    }
+  }
+
+  size_t count = 0;
+  for(auto ops : operations) {
+    if(ops->size() > APPLY_BATCH_MAX_OPS) {
+      return APPLY_NOT_SINGLE_TRANSACTION;
     }
+    count += ops->size();
+  }
+
+  Ethereum ethInstance(std::move(connection_string), "",
+                       std::move(from_address), max_waiting_time, fee_config, layout);
+
+  const std::string selector = layout == STORE_LAYOUT_MULTI ? "0x834b8b14" : "0x66375058";
+  size_t max_ops = ethInstance.max_ops_per_transaction(
+      gas_model.gas_per_op(ethInstance.gas_model_key(selector), GAS_PER_PUT_OP));
+  if(count > max_ops) {
+    std::stringstream msg;
+    msg << count << " operations do not fit into one transaction (max. " << max_ops << ")";
+    log(msg.str(), "atomicApply");
+    return APPLY_NOT_SINGLE_TRANSACTION;
+  }
 
-    boost::to_lower(address);
-    address_string << std::setw(64) << std::setfill('0') << address;
+  auto n = contracts.size();
+  std::stringstream data_string;
+  data_string << numeric_to_hex(64);
+  data_string << numeric_to_hex(96 + 32 * n);
+
+  // All store addresses (or table ids)
+  data_string << encode_store_array(contracts);
+
+  // Operations of each store, encoded as arguments of applyBatch(bytes32[],bytes32[],uint256)
+  std::vector<std::string> encoded_ops;
+  for(auto ops : operations) {
+    encoded_ops.emplace_back(encode_apply_batch(ops, 0, ops->size(), TXID{{0}}));
+  }
+
+  data_string << numeric_to_hex(n);
+  size_t offset = 32 * n;
+  for(auto& encoded : encoded_ops) {
+    data_string << numeric_to_hex(offset);
+    offset += 32 + encoded.size() / 2;
+  }
+  for(auto& encoded : encoded_ops) {
+    data_string << numeric_to_hex(encoded.size() / 2); // length in bytes
+    data_string << encoded;
   }
 
   RPC_params params;
   params.method = "eth_sendTransaction";
-  params.data = "0x334c1176" + txidVal + address_string.str();
-  params.to = std::move(commit_contract_address);
+  params.op_count = count;
+  params.gas_per_op = GAS_PER_PUT_OP;
+
+  params.data = selector + data_string.str();
+  if(layout == STORE_LAYOUT_MULTI) {
+    // applyAll(uint32[],bytes[]) of multi-table store
+    params.to = contracts[0].address;
+  } else {
+    // applyAll(address[],bytes[]) of commit contract
+    params.to = std::move(commit_contract_address);
+    if(use_access_lists) params.access_list = ethInstance.create_access_list(params);
+  }
 
   const std::string response = ethInstance.call(params, true);
 
   if (response.find("error") == std::string::npos) {
-    log("success", "atomicCommit");
+    log("success", "atomicApply");
     return 0;
   } else {
-    log("Failed: " + response, "atomicCommit");
+    log("Failed: " + response, "atomicApply");
+    return 1;
+  }
+}
+
+/*
+ * ---- LOG STORE IMPLEMENTATION ----------------------------------
+ */
+
+Ethereum_log::Ethereum_log(std::string connection_string,
+                           std::string store_contract_address,
+                           std::string from_address,
+                           int max_waiting_time,
+                           Fee_config fee_config,
+                           uint64 first_block)
+    : Ethereum(std::move(connection_string), std::move(store_contract_address),
+               std::move(from_address), max_waiting_time, fee_config, STORE_LAYOUT_LOG),
+      first_block(first_block) {
+  state = Log_table_state::get(_store_contract_address);
+}
+
+/*
+ * KVLog encoding of operations [begin, end): key length (highest bit set for removes), key
+ * and, for puts, value length, value
+ */
+static std::string encode_log_ops(std::vector<Batch_op> * data, size_t begin, size_t end) {
+  std::stringstream ops;
+  for(ulong i=begin; i<end; i++) {
+    auto& op = data->at(i);
+    if(op.remove) {
+      append_packed(ops, op.key, 0x80);
+    } else {
+      append_packed(ops, op.key);
+      append_packed(ops, op.value);
+    }
+  }
+
+  return ops.str();
+}
+
+static std::vector<Log_table_state::Op> decode_log_ops(const std::string& data) {
+  std::vector<Log_table_state::Op> ops;
+  if(data.size() < 2 + 128) {
+    return ops;
+  }
+
+  // skip "0x" and offset of bytes
+  size_t length = strtoull(data.substr(2 + 64, 64).c_str(), nullptr, 16);
+  std::vector<byte> bytes(length);
+  parse_32byte_hex_string(data.substr(2 + 128), bytes.data(), std::min(length, (data.size() - 130) / 2));
+
+  auto read_element = [&bytes](size_t& pos, std::string& element, size_t element_length) {
+    if(element_length > 32 || pos + element_length > bytes.size()) {
+      return false;
+    }
+    element.assign(32, 0);
+    std::copy(bytes.begin() + pos, bytes.begin() + pos + element_length, element.begin());
+    pos += element_length;
+    return true;
+  };
+
+  size_t pos = 0;
+  while(pos < bytes.size()) {
+    Log_table_state::Op op;
+    op.remove = (bytes[pos] & 0x80) != 0;
+    size_t key_length = bytes[pos++] & 0x7f;
+    if(!read_element(pos, op.key, key_length)) {
+      break;
+    }
+
+    if(!op.remove) {
+      if(pos >= bytes.size()) {
+        break;
+      }
+      size_t value_length = bytes[pos++];
+      if(!read_element(pos, op.value, value_length)) {
+        break;
+      }
+    }
+
+    ops.emplace_back(std::move(op));
+  }
+
+  return ops;
+}
+
+/*
+ * eth_getBlockByNumber without transactions, returns false if the node can not be asked
+ */
+static bool get_block_header(Ethereum& eth, const std::string& tag, Block_header& block) {
+  std::string param = "\"" + tag + "\", false";
+  std::string method = "eth_getBlockByNumber";
+  const std::string response = eth.call(param, method);
+
+  try {
+    auto& result = nlohmann::json::parse(response).at("result");
+    if(result.is_null()) {
+      block = Block_header{0, "", ""};
+      return true;
+    }
+    block.number = parse_hex_quantity(result.at("number").get<std::string>());
+    block.hash = result.at("hash").get<std::string>();
+    block.parent_hash = result.at("parentHash").get<std::string>();
+    return true;
+  } catch (std::exception&) {
+    log("Can not parse eth_getBlockByNumber response: " + response, "sync");
+    return false;
+  }
+}
+
+/*
+ * First block with code at the store address (binary search with eth_getCode, once per table).
+ * Needs the state of old blocks (archive node), otherwise 0 is returned.
+ */
+uint64 Ethereum_log::find_deployment_block(uint64 latest) {
+  uint64 low = 0;
+  uint64 high = latest;
+  while(low < high) {
+    uint64 mid = low + (high - low) / 2;
+    std::string param = "\"" + _store_contract_address + "\", \"" + to_hex_quantity(mid) + "\"";
+    std::string method = "eth_getCode";
+    const std::string response = call(param, method);
+
+    try {
+      bool deployed = nlohmann::json::parse(response).at("result").get<std::string>() != "0x";
+      if(deployed) {
+        high = mid;
+      } else {
+        low = mid + 1;
+      }
+    } catch (std::exception&) {
+      log("Can not look up deployment block, syncing from block 0 (configure it as "
+          "tableName:address:log:block): " + response, "sync");
+      return 0;
+    }
+  }
+
+  return low;
+}
+
+/*
+ * Applies all logs of blocks that were mined since the last sync to the local table state.
+ * Runs at most every LOG_SYNC_INTERVAL ms (unless this server wrote to the table), the range
+ * is fetched in pages of LOG_SYNC_PAGE_BLOCKS blocks. Must not be called with state->mtx held.
+ */
+void Ethereum_log::sync() {
+  std::lock_guard<std::mutex> sync_lock(state->sync_mtx);
+  auto now = std::chrono::steady_clock::now();
+  if(!state->written.exchange(false)
+     && now - state->last_sync < std::chrono::milliseconds(LOG_SYNC_INTERVAL)) {
+    return; // synced recently (possibly by a concurrent reader)
+  }
+
+  Block_header latest;
+  if(!get_block_header(*this, "latest", latest) || latest.hash.empty()) {
+    return;
+  }
+
+  if(!state->started) {
+    state->next_block = first_block > 0 ? first_block : find_deployment_block(latest.number);
+    state->started = true;
+    log("Syncing from block " + std::to_string(state->next_block), "sync");
+  }
+
+  if(!undo_reorg(latest)) {
+    return;
+  }
+
+  uint64 final_block = latest.number > LOG_REORG_DEPTH ? latest.number - LOG_REORG_DEPTH : 0;
+  while(state->next_block <= latest.number) {
+    uint64 to_block = std::min(latest.number, state->next_block + LOG_SYNC_PAGE_BLOCKS - 1);
+    if(!sync_page(state->next_block, to_block)) {
+      return; // retried by the next read
+    }
+    state->next_block = to_block + 1;
+
+    std::lock_guard<std::mutex> lock(state->mtx);
+    state->confirm(final_block);
+  }
+
+  // the logs may be of a fork replaced after latest was read: then the next sync finds a reorg
+  if(state->next_block == latest.number + 1) {
+    state->block_hashes[latest.number] = latest.hash;
+  }
+  state->block_hashes.erase(state->block_hashes.begin(), state->block_hashes.lower_bound(final_block));
+  state->last_sync = now;
+}
+
+/*
+ * Checks if the blocks synced last are still part of the chain. Otherwise, the changes from
+ * the reorged blocks are undone and the sync continues after the last synced block still on
+ * the chain (or the oldest one that can be undone, for reorgs deeper than LOG_REORG_DEPTH).
+ * Returns false if the node can not be asked.
+ */
+bool Ethereum_log::undo_reorg(const Block_header& latest) {
+  auto& hashes = state->block_hashes;
+  if(hashes.empty()) {
+    return true;
+  }
+
+  auto head = std::prev(hashes.end());
+  if((latest.number == head->first && latest.hash == head->second) ||
+     (latest.number == head->first + 1 && latest.parent_hash == head->second)) {
+    return true;
+  }
+
+  uint64 fork_block = hashes.begin()->first;
+  for(auto synced = hashes.rbegin(); synced != hashes.rend(); ++synced) {
+    Block_header block;
+    if(synced->first > latest.number) {
+      continue; // no longer on the chain
+    }
+    if(!get_block_header(*this, to_hex_quantity(synced->first), block)) {
+      return false;
+    }
+    if(block.hash == synced->second) {
+      fork_block = synced->first + 1;
+      break;
+    }
+  }
+
+  if(fork_block >= state->next_block) {
+    return true; // only blocks after the last synced one changed
+  }
+
+  log("Reorg: undoing changes of blocks from " + std::to_string(fork_block), "sync");
+  {
+    std::lock_guard<std::mutex> lock(state->mtx);
+    state->rollback(fork_block);
+  }
+  hashes.erase(hashes.lower_bound(fork_block), hashes.end());
+  state->next_block = fork_block;
+  return true;
+}
+
+/*
+ * Fetches the logs of blocks [from_block, to_block] and applies them (all or none)
+ */
+bool Ethereum_log::sync_page(uint64 from_block, uint64 to_block) {
+  struct Event {
+    std::string topic;
+    std::string tx_id;
+    std::vector<Log_table_state::Op> ops;
+    uint64 block;
+  };
+
+  std::string filter = R"({"address":")" + _store_contract_address
+                       + R"(","fromBlock":")" + to_hex_quantity(from_block)
+                       + R"(","toBlock":")" + to_hex_quantity(to_block) + "\"}";
+  std::string method = "eth_getLogs";
+  const std::string response = call(filter, method);
+
+  std::vector<Event> events;
+  try {
+    auto logs = nlohmann::json::parse(response).at("result");
+    const std::string nil_tx_id = "0x" + std::string(64, '0');
+
+    for(auto& entry : logs) {
+      if(entry.value("removed", false)) {
+        continue; // log of block that is no longer part of the chain
+      }
+
+      auto& topics = entry.at("topics");
+      Event event;
+      event.topic = topics.at(0).get<std::string>();
+      event.tx_id = topics.size() > 1 ? topics.at(1).get<std::string>() : "";
+      if(event.tx_id == nil_tx_id) event.tx_id = "";
+      event.block = parse_hex_quantity(entry.at("blockNumber").get<std::string>());
+      if(event.topic == LOG_EVENT_OPS) {
+        event.ops = decode_log_ops(entry.at("data").get<std::string>());
+      }
+      events.emplace_back(std::move(event));
+    }
+  } catch (std::exception&) {
+    log("Can not parse eth_getLogs response: " + response, "sync");
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(state->mtx);
+  for(auto& event : events) {
+    if(event.topic == LOG_EVENT_OPS) {
+      state->append(event.tx_id, std::move(event.ops), event.block);
+    } else if(event.topic == LOG_EVENT_COMMIT) {
+      state->commit(event.tx_id, event.block);
+    } else if(event.topic == LOG_EVENT_CLEAN) {
+      state->clean(event.tx_id, event.block);
+    }
+  }
+
+  return true;
+}
+
+int Ethereum_log::get(Byte_data* key, unsigned char* buf, int value_size) {
+  std::string padded_key(32, 0);
+  memcpy(&padded_key[0], key->data, std::min((int) key->data_size, 32));
+
+  sync();
+  std::lock_guard<std::mutex> lock(state->mtx);
+
+  auto row = state->rows.find(padded_key);
+  if(row == state->rows.end()) {
+    log("No value for key found", "Get");
+    return HA_ERR_END_OF_FILE;
+  }
+
+  memcpy(&(buf[0]), key->data, key->data_size);
+  memset(&(buf[key->data_size]), 0, value_size);
+  memcpy(&(buf[key->data_size]), row->second.value.data(), std::min(value_size, 32));
+  return 0;
+}
+
+static Managed_byte_data copy_byte_data(Byte_data* data) {
+  Managed_byte_data copy(data->data_size);
+  memcpy(copy.data->data(), data->data, data->data_size);
+  return copy;
+}
+
+int Ethereum_log::put(Byte_data* key, Byte_data* value, TXID txid) {
+  std::vector<Batch_op> ops{Batch_op{copy_byte_data(key), copy_byte_data(value), false}};
+
+  RPC_params params;
+  params.method = "eth_sendTransaction";
+  params.data = std::string(txid.is_nil() ? "0x1963f2b3" : "0x74fbed60")
+                + encode_bytes_argument(encode_log_ops(&ops, 0, 1), txid);
+
+  const std::string response = call(params, true);
+  state->written = true;
+
+  if (response.find("error") == std::string::npos) {
+    log("success", "Put");
+    return 0;
+  } else {
+    log("Failed: " + response, "Put");
+    return 1;
+  }
+}
+
+int Ethereum_log::remove(Byte_data* key, TXID txid) {
+  std::vector<Batch_op> ops{Batch_op{copy_byte_data(key), Managed_byte_data(), true}};
+
+  RPC_params params;
+  params.method = "eth_sendTransaction";
+  params.data = std::string(txid.is_nil() ? "0x1963f2b3" : "0x74fbed60")
+                + encode_bytes_argument(encode_log_ops(&ops, 0, 1), txid);
+
+  const std::string response = call(params, true);
+  state->written = true;
+
+  if (response.find("error") == std::string::npos) {
+    log("success", "Remove");
+    return 0;
+  } else {
+    log("Failed: " + response, "Remove");
     return 1;
   }
 }
 
+int Ethereum_log::submit_put_batch(std::vector<Put_op>* data, TXID txid) {
+  std::vector<Batch_op> ops;
+  ops.reserve(data->size());
+  for(auto& put_op : *data) {
+    ops.push_back(Batch_op{put_op.key, put_op.value, false});
+  }
+
+  return submit_apply_batch(&ops, txid);
+}
+
+int Ethereum_log::submit_remove_batch(std::vector<Remove_op>* data, TXID txid) {
+  std::vector<Batch_op> ops;
+  ops.reserve(data->size());
+  for(auto& remove_op : *data) {
+    ops.push_back(Batch_op{remove_op.key, Managed_byte_data(), true});
+  }
+
+  return submit_apply_batch(&ops, txid);
+}
+
+int Ethereum_log::submit_apply_batch(std::vector<Batch_op>* data, TXID txid) {
+  auto encode_chunk = [&data, &txid](size_t begin, size_t end) {
+    return encode_bytes_argument(encode_log_ops(data, begin, end), txid);
+  };
+
+  if(txid.is_nil()) {
+    return send_in_chunks("append", "0x1963f2b3", GAS_PER_LOG_OP, data->size(), encode_chunk);
+  } else {
+    return send_in_chunks("append", "0x74fbed60", GAS_PER_LOG_OP, data->size(), encode_chunk);
+  }
+}
+
+int Ethereum_log::wait_for_submitted() {
+  int rc = Ethereum::wait_for_submitted();
+  state->written = true; // mined operations are read by the next sync
+  return rc;
+}
+
+int Ethereum_log::apply_single_transaction(std::vector<Batch_op>* data) {
+  auto encode_chunk = [&data](size_t begin, size_t end) {
+    return encode_bytes_argument(encode_log_ops(data, begin, end), {{0}});
+  };
+
+  int rc = send_in_chunks("append", "0x1963f2b3", GAS_PER_LOG_OP, data->size(), encode_chunk,
+                          SIZE_MAX, nullptr, false);
+  if(rc == APPLY_NOT_SINGLE_TRANSACTION) {
+    return rc;
+  }
+  return std::max(rc, wait_for_submitted());
+}
+
+void Ethereum_log::table_scan_to_vec(std::vector<Managed_byte_data> &tuples,
+                                     const size_t key_length, const size_t value_length) {
+  sync();
+  std::lock_guard<std::mutex> lock(state->mtx);
+
+  tuples.reserve(state->rows.size());
+  for(auto& row : state->rows) {
+    auto tuple = Managed_byte_data(key_length + value_length);
+    memcpy(tuple.data->data(), row.first.data(), std::min(key_length, (size_t) 32));
+    memcpy(&((*tuple.data)[key_length]), row.second.value.data(), std::min(value_length, (size_t) 32));
+    tuples.emplace_back(std::move(tuple));
+  }
+}
+
+void Ethereum_log::table_scan_to_map(tx_cache_t& tuples, size_t key_length, size_t value_length) {
+  sync();
+  std::lock_guard<std::mutex> lock(state->mtx);
+
+  tuples.reserve(tuples.size() + state->rows.size());
+  for(auto& row : state->rows) {
+    //IMPORTANT: Only insert if value does not exist yet --> ensure data is read only once (--> anomalies)
+    tuples.insert(reinterpret_cast<const byte*>(row.first.data()), key_length,
+                  reinterpret_cast<const byte*>(row.second.value.data()), value_length);
+  }
+}
+
+/*
+ * ---- ROLLUP IMPLEMENTATION ----------------------------------
+ */
+
+/*
+ * Publisher threads of all rollup tables, stopped by Ethereum_rollup::stop_publishers()
+ */
+static struct {
+  std::mutex mtx;
+  std::condition_variable stop_requested;
+  bool stopping{false};
+  std::vector<std::thread> threads;
+} publishers;
+
+/*
+ * Sends the diff of the next batch every batch_interval seconds: submitBatch(root, diff).
+ * A diff that does not fit into one transaction is split into chunks, each with its own root.
+ */
+static void publish_batches(std::shared_ptr<Rollup_state> state, std::unique_ptr<Ethereum> connector) {
+  while(true) {
+    {
+      std::unique_lock<std::mutex> lock(publishers.mtx);
+      if(publishers.stop_requested.wait_for(lock, std::chrono::seconds(Ethereum_rollup::batch_interval),
+                                            [] { return publishers.stopping; })) {
+        return; // unpublished diff stays in the journal
+      }
+    }
+
+    std::vector<Rollup_state::Op> batch;
+    uint64_t journal_offset;
+    if(!state->take_batch(batch, journal_offset)) {
+      continue;
+    }
+
+    std::vector<Batch_op> ops;
+    ops.reserve(batch.size());
+    for(auto& op : batch) {
+      Batch_op batch_op{Managed_byte_data(32), Managed_byte_data(32), op.remove};
+      memcpy(batch_op.key.data->data(), op.key.data(), 32);
+      if(!op.remove) memcpy(batch_op.value.data->data(), op.value.data(), 32);
+      ops.emplace_back(std::move(batch_op));
+    }
+
+    // Chunk of the diff (sorted by key): root of its own operations, diff as KVLog ops
+    auto encode_chunk = [&batch, &ops](size_t begin, size_t end) {
+      std::string root = Rollup_state::merkle_root(std::vector<Rollup_state::Op>(batch.begin() + begin,
+                                                                                 batch.begin() + end));
+      Byte_data bdRoot(reinterpret_cast<byte*>(&root[0]), 32);
+      return byte_array_to_hex(&bdRoot) + encode_bytes_argument(encode_log_ops(&ops, begin, end), {{0}}, 32);
+    };
+
+    int rc = connector->send_in_chunks("submitBatch", "0xdb6bbab9", GAS_PER_LOG_OP, ops.size(), encode_chunk);
+    rc = std::max(rc, connector->wait_for_submitted());
+
+    if (rc == 0) {
+      log("published batch with " + std::to_string(ops.size()) + " operations", "publishBatches");
+      state->batch_published(journal_offset);
+    } else {
+      // published chunks are published again with the next batch (same rows, new roots)
+      log("Failed to publish batch with " + std::to_string(ops.size()) + " operations", "publishBatches");
+      state->batch_failed(batch);
+    }
+  }
+}
+
+void Ethereum_rollup::stop_publishers() {
+  std::vector<std::thread> threads;
+  {
+    std::lock_guard<std::mutex> lock(publishers.mtx);
+    publishers.stopping = true;
+    threads.swap(publishers.threads);
+  }
+  publishers.stop_requested.notify_all();
+
+  for(auto& thread : threads) {
+    thread.join(); // a batch being sent is awaited (max. max_waiting_time)
+  }
+}
+
+Ethereum_rollup::Ethereum_rollup(std::string connection_string,
+                                 std::string store_contract_address,
+                                 std::string from_address,
+                                 int max_waiting_time,
+                                 Fee_config fee_config)
+    : Ethereum(connection_string, store_contract_address,
+               from_address, max_waiting_time, fee_config, STORE_LAYOUT_ROLLUP) {
+  state = Rollup_state::get(_store_contract_address);
+
+  if(state->start_publisher()) {
+    auto publisher = std::make_unique<Ethereum>(std::move(connection_string), std::move(store_contract_address),
+                                                std::move(from_address), max_waiting_time, fee_config,
+                                                STORE_LAYOUT_ROLLUP);
+    std::lock_guard<std::mutex> lock(publishers.mtx);
+    if(!publishers.stopping) {
+      publishers.threads.emplace_back(publish_batches, state, std::move(publisher));
+    }
+  }
+}
+
+static std::string padded_32(const byte* data, size_t size) {
+  std::string padded(32, 0);
+  memcpy(&padded[0], data, std::min(size, (size_t) 32));
+  return padded;
+}
+
+static std::string tx_id_string(TXID txid) {
+  Byte_data bdTxid(txid.data, 16);
+  return byte_array_to_hex(&bdTxid, 16);
+}
+
+/*
+ * Journals operations directly or keeps them until commit of the transaction (see commit_prepared)
+ */
+int Ethereum_rollup::write(std::vector<Rollup_state::Op>&& ops, TXID txid) {
+  if(!txid.is_nil()) {
+    state->prepare(tx_id_string(txid), std::move(ops));
+    return 0;
+  }
+
+  if(state->commit(std::move(ops)) != 0) {
+    log("Failed: operations could not be journaled", "Write");
+    return 1;
+  }
+
+  return 0;
+}
+
+int Ethereum_rollup::commit_prepared(const Table_contract& contract, TXID tx_ID) {
+  return Rollup_state::get(contract.address)->commit_prepared(tx_id_string(tx_ID));
+}
+
+int Ethereum_rollup::clear_commit_prepare(boost::uuids::uuid tx_ID) {
+  state->clean(tx_id_string(tx_ID));
+  return 0;
+}
+
+int Ethereum_rollup::get(Byte_data* key, unsigned char* buf, int value_size) {
+  std::lock_guard<std::mutex> lock(state->mtx);
+
+  auto row = state->rows.find(padded_32(key->data, key->data_size));
+  if(row == state->rows.end()) {
+    log("No value for key found", "Get");
+    return HA_ERR_END_OF_FILE;
+  }
+
+  memcpy(&(buf[0]), key->data, key->data_size);
+  memset(&(buf[key->data_size]), 0, value_size);
+  memcpy(&(buf[key->data_size]), row->second.data(), std::min(value_size, 32));
+  return 0;
+}
+
+int Ethereum_rollup::put(Byte_data* key, Byte_data* value, TXID txid) {
+  std::vector<Rollup_state::Op> ops;
+  ops.push_back(Rollup_state::Op{padded_32(key->data, key->data_size),
+                                 padded_32(value->data, value->data_size), false});
+  return write(std::move(ops), txid);
+}
+
+int Ethereum_rollup::put_batch(std::vector<Put_op>* data, TXID txid) {
+  std::vector<Rollup_state::Op> ops;
+  ops.reserve(data->size());
+  for(auto& put_op : *data) {
+    ops.push_back(Rollup_state::Op{padded_32(put_op.key.data->data(), put_op.key.data->size()),
+                                   padded_32(put_op.value.data->data(), put_op.value.data->size()), false});
+  }
+
+  return write(std::move(ops), txid);
+}
+
+int Ethereum_rollup::remove(Byte_data* key, TXID txid) {
+  std::vector<Rollup_state::Op> ops;
+  ops.push_back(Rollup_state::Op{padded_32(key->data, key->data_size), "", true});
+  return write(std::move(ops), txid);
+}
+
+int Ethereum_rollup::remove_batch(std::vector<Remove_op>* data, TXID txid) {
+  std::vector<Rollup_state::Op> ops;
+  ops.reserve(data->size());
+  for(auto& remove_op : *data) {
+    ops.push_back(Rollup_state::Op{padded_32(remove_op.key.data->data(), remove_op.key.data->size()), "", true});
+  }
+
+  return write(std::move(ops), txid);
+}
+
+int Ethereum_rollup::submit_put_batch(std::vector<Put_op>* data, TXID txid) {
+  return put_batch(data, txid); // journal writes are synchronous
+}
+
+int Ethereum_rollup::submit_remove_batch(std::vector<Remove_op>* data, TXID txid) {
+  return remove_batch(data, txid);
+}
+
+int Ethereum_rollup::apply_batch(std::vector<Batch_op>* data, TXID txid) {
+  std::vector<Rollup_state::Op> ops;
+  ops.reserve(data->size());
+  for(auto& op : *data) {
+    ops.push_back(Rollup_state::Op{padded_32(op.key.data->data(), op.key.data->size()),
+                                   op.remove ? "" : padded_32(op.value.data->data(), op.value.data->size()),
+                                   op.remove});
+  }
+
+  return write(std::move(ops), txid);
+}
+
+int Ethereum_rollup::submit_apply_batch(std::vector<Batch_op>* data, TXID txid) {
+  return apply_batch(data, txid);
+}
+
+int Ethereum_rollup::apply_single_transaction(std::vector<Batch_op>* data) {
+  return apply_batch(data, {{0}}); // one journal record, independent of block gas limit
+}
+
+void Ethereum_rollup::table_scan_to_vec(std::vector<Managed_byte_data> &tuples,
+                                        const size_t key_length, const size_t value_length) {
+  std::lock_guard<std::mutex> lock(state->mtx);
+
+  tuples.reserve(state->rows.size());
+  for(auto& row : state->rows) {
+    auto tuple = Managed_byte_data(key_length + value_length);
+    memcpy(tuple.data->data(), row.first.data(), std::min(key_length, (size_t) 32));
+    memcpy(&((*tuple.data)[key_length]), row.second.data(), std::min(value_length, (size_t) 32));
+    tuples.emplace_back(std::move(tuple));
+  }
+}
+
+void Ethereum_rollup::table_scan_to_map(tx_cache_t& tuples, size_t key_length, size_t value_length) {
+  std::lock_guard<std::mutex> lock(state->mtx);
+
+  tuples.reserve(tuples.size() + state->rows.size());
+  for(auto& row : state->rows) {
+    //IMPORTANT: Only insert if value does not exist yet --> ensure data is read only once (--> anomalies)
+    tuples.insert(reinterpret_cast<const byte*>(row.first.data()), key_length,
+                  reinterpret_cast<const byte*>(row.second.data()), value_length);
+  }
+}
+
 /*
  * {
 	"93ec62c1": "clean(bytes16)",
@@ -614,14 +2081,51 @@ int Ethereum::atomic_commit(std::string connection_string,
 	"3c58dd03": "put(bytes32,bytes32,bytes16)",
 	"9b36675c": "putBatch(bytes32[],bytes32[])",
 	"0238a793": "putBatch(bytes32[],bytes32[],bytes16)",
+        "ac42e005": "putBatchPacked(bytes)",
+        "7c312dbf": "putBatchPacked(bytes,bytes16)",
 	"95bc2673": "remove(bytes32)",
 	"29a32c0a": "remove(bytes32,bytes16)",
         "2d9bb756": "removeBatch(bytes32[])",
         "702de045": "removeBatch(bytes32[],bytes16)",
+        "528d092e": "applyBatch(bytes32[],bytes32[],uint256)",
+        "fce5533c": "applyBatch(bytes32[],bytes32[],uint256,bytes16)",
 	"b3055e26": "tableScan()"
 }
 
 {
-        "334c1176": "commitAll(bytes16,address[])"
+        "334c1176": "commitAll(bytes16,address[])",
+        "66375058": "applyAll(address[],bytes[])"
+}
+
+{
+        "519b771a": "get(uint32,bytes32)",
+        "83966885": "put(uint32,bytes32,bytes32)",
+        "b591e52c": "put(uint32,bytes32,bytes32,bytes16)",
+        "2c844e5c": "putBatchPacked(uint32,bytes)",
+        "4b045551": "putBatchPacked(uint32,bytes,bytes16)",
+        "25b36e26": "remove(uint32,bytes32)",
+        "4666b617": "remove(uint32,bytes32,bytes16)",
+        "7ee81297": "removeBatch(uint32,bytes32[])",
+        "2f9908c2": "removeBatch(uint32,bytes32[],bytes16)",
+        "0e0b6123": "applyBatch(uint32,bytes32[],bytes32[],uint256)",
+        "47a331ab": "applyBatch(uint32,bytes32[],bytes32[],uint256,bytes16)",
+        "834b8b14": "applyAll(uint32[],bytes[])",
+        "dbc134d2": "commitAll(bytes16,uint32[])",
+        "1e1594ba": "clean(uint32,bytes16)",
+        "e09ff0eb": "tableScan(uint32)"
+}
+
+{
+        "1963f2b3": "append(bytes)",
+        "74fbed60": "append(bytes,bytes16)",
+        "8fcdc9a9": "commit(bytes16)",
+        "93ec62c1": "clean(bytes16)"
+}
+
+{
+        "06f13056": "batchCount()",
+        "c2b40ae4": "roots(uint256)",
+        "db6bbab9": "submitBatch(bytes32,bytes)",
+        "bc7ec9a8": "verify(uint256,bytes32,bytes32,bool,bytes32[])"
 }
  */
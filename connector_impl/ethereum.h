@@ -8,18 +8,78 @@
 #include <cassert>
 #include <iostream>
 #include <regex>
+#include <set>
 #include <string>
 #include <include/my_base.h>
 #include <boost/algorithm/string.hpp>
 #include <cmath>
+#include <cstring>
+#include <functional>
 #include <iomanip>
 #include <thread>
 #include <utility>
 
 #include "json.hpp"
+#include "gas_model.h"
+#include "keccak.h"
+#include "log_table_state.h"
+#include "rollup_state.h"
 
 #define MINING_CHECK_INTERVAL 200
 
+// Gas values used if the gas model has no observations yet (see KVStore contract)
+#define ATOMIC_COMMIT_UNKNOWN 2     // atomic_commit: commit transaction sent, but outcome unknown (not mined in time)
+#define TX_DEFAULT_GAS 500000       // 0x7A120, used if eth_estimateGas fails
+#define GAS_PER_PUT_OP 95000        // put of a new key: 2 data slots + keyList entry + keyIndex entry
+#define GAS_PER_PUT_OP_V2 75000     // put of a new key in KVStoreV2: value slot + entry slot + keyList entry
+// remove (KVStore, before refunds, which only apply after execution): cold keyIndex, keyList
+// length and last entry loads (3 * 2100), keyList swap and keyIndex update of the last key
+// (2 * 5000), pop and keyIndex delete (3 * 2900), data delete (2 * 5000), ~2000 calldata and loop
+#define GAS_PER_REMOVE_OP 40000     // independent of table size, KVStoreV2 and multi-table store use less
+#define GAS_PER_TX_BUFFER_OP 70000  // push of one TxOperation (3 slots) to txBuffer
+#define GAS_PER_LOG_OP 2000         // calldata and event data of one operation of KVLog.append
+
+// Storage slots of state variables in the store contracts, used for EIP-2930 access lists
+#define KVSTORE_SLOT_DATA 0          // KVStore: mapping(bytes32 => Value), 2 slots per value
+#define KVSTORE_SLOT_KEY_LIST 1
+#define KVSTORE_SLOT_KEY_INDEX 2
+#define KVSTORE_V2_SLOT_ENTRIES 0    // KVStoreV2: mapping(bytes32 => Entry)
+#define KVSTORE_V2_SLOT_DATA 1
+#define KVSTORE_V2_SLOT_KEY_LIST 2
+#define KVSTORE_MULTI_SLOT_ENTRIES 0 // KVStoreMulti: same as KVStoreV2, with mapping by table id first
+#define KVSTORE_MULTI_SLOT_DATA 1
+#define KVSTORE_MULTI_SLOT_KEY_LISTS 2
+// EIP-2929/2930 gas: a listed slot costs 1900 and its access 100 instead of 2100 (saves 100),
+// the address entry of the list costs 2400 (the called contract is warm anyway)
+#define ACCESS_LIST_ADDRESS_GAS 2400
+#define ACCESS_LIST_SLOT_SAVING 100
+#define BLOCK_GAS_LIMIT_USAGE 0.9   // max. share of the block gas limit used by one transaction
+#define APPLY_BATCH_MAX_OPS 256     // size of delete bitmap of applyBatch
+
+// Fee strategy (see Fee_config)
+#define FEE_HISTORY_BLOCKS 5        // number of blocks considered by eth_feeHistory
+#define FEE_REWARD_PERCENTILE 50    // priority fee percentile of these blocks
+
+enum FEE_POLICY {
+  FEE_NODE_DEFAULT = 0,  // no fee fields, node decides (no replacement possible)
+  FEE_LEGACY = 1,        // gasPrice based on eth_gasPrice
+  FEE_EIP1559 = 2        // maxFeePerGas / maxPriorityFeePerGas based on eth_feeHistory
+};
+
+/*
+ * Key of an operation sent directly to the store, for the access list (see build_access_list)
+ */
+struct Access_key {
+  Byte_data key;
+  bool remove;  // touches other slots than a put
+};
+
+struct Fee_config {
+  int policy;
+  int bump_percent;    // fee increase of a replacement transaction
+  int replace_after;   // seconds a transaction may be pending before it is replaced
+};
+
 struct RPC_params {
   std::string from;
   std::string to;
@@ -27,10 +87,27 @@ struct RPC_params {
   std::string method;
   std::string gas;
   std::string gas_price;
+  std::string max_fee_per_gas;
+  std::string max_priority_fee_per_gas;
+  std::string access_list;  // JSON array of EIP-2930 access list entries
   std::string quantity_tag;
   std::string transaction_ID;
   uint64 nonce;
-  RPC_params() : nonce(0) {}
+  size_t op_count;  // number of operations in transaction for gas model, 0: gas depends on contract state
+  uint64 gas_per_op; // upper bound of gas per operation (e.g. new keys), 0: unknown --> eth_estimateGas
+  RPC_params() : nonce(0), op_count(1), gas_per_op(0) {}
+};
+
+
+/*
+ * Sent transaction which is not known to be mined yet. If it is replaced by a transaction
+ * with the same nonce and a higher fee, all hashes are tracked until one of them is mined.
+ */
+struct Pending_transaction {
+  std::vector<std::string> hashes;
+  RPC_params params;      // params of latest submission (including nonce and fees)
+  size_t submitted_at;    // ms since start of waiting
+  bool retried{false};    // sent again after running out of gas
 };
 
 
@@ -64,7 +141,10 @@ public:
     explicit Ethereum(std::string connection_string,
                    std::string store_contract_address,
                    std::string from_address,
-                   int max_waiting_time);
+                   int max_waiting_time,
+                   Fee_config fee_config,
+                   int layout = STORE_LAYOUT_V1,
+                   uint32_t table_id = 0);
     ~Ethereum() override;
 
     int get(Byte_data* key, unsigned char* buf, int value_size) override;
@@ -72,32 +152,170 @@ public:
     int put_batch(std::vector<Put_op> * data, TXID txID) override;
     int remove(Byte_data *key, TXID txID) override;
     int remove_batch(std::vector<Remove_op> * data, TXID txID) override;
+    int submit_put_batch(std::vector<Put_op> * data, TXID txID) override;
+    int submit_remove_batch(std::vector<Remove_op> * data, TXID txID) override;
+    int apply_batch(std::vector<Batch_op> * data, TXID txID) override;
+    int submit_apply_batch(std::vector<Batch_op> * data, TXID txID) override;
+    int apply_single_transaction(std::vector<Batch_op> * data) override;
+    int wait_for_submitted() override;
     void table_scan_to_vec(std::vector<Managed_byte_data> &tuples, size_t key_length, size_t value_length) override;
     void table_scan_to_map(tx_cache_t& tuples, size_t key_kength, size_t value_length) override;
     int drop_table() override;
     int clear_commit_prepare(boost::uuids::uuid tx_ID) override;
 
-    std::string call(RPC_params params, bool set_gas);
+    std::string call(RPC_params params, bool set_gas, bool wait_for_mining = true,
+                     Pending_transaction* sent = nullptr);
     std::string call(std::string& params, std::string& method);
-    std::string check_mining_result(std::string& transaction_ID);
+    std::string check_mining_result(Pending_transaction& transaction);
+    bool check_mining_results(std::vector<Pending_transaction> transactions, bool* timed_out = nullptr);
+    static bool is_atomic_commit_supported(const std::vector<Table_contract>& contracts);
+    // 0: committed, 1: failed (nothing committed), ATOMIC_COMMIT_UNKNOWN: sent, outcome unknown
     static int atomic_commit(std::string connection_string,
                             std::string from_address,
                             int max_waiting_time,
+                            Fee_config fee_config,
                             std::string commit_contract_address, TXID tx_ID,
-                            const std::vector<std::string>& addresses);
+                            const std::vector<Table_contract>& contracts);
+    // 0: applied, 1: failed, APPLY_NOT_SINGLE_TRANSACTION: do not fit into one transaction (nothing sent)
+    static int atomic_apply(std::string connection_string,
+                            std::string from_address,
+                            int max_waiting_time,
+                            Fee_config fee_config,
+                            std::string commit_contract_address,
+                            const std::vector<Table_contract>& contracts,
+                            const std::vector<std::vector<Batch_op>*>& operations);
 
-   private:
+    // sends count operations in chunks that fit into a block, awaited by wait_for_submitted()
+    // without split: APPLY_NOT_SINGLE_TRANSACTION (nothing sent) if more than one chunk is needed
+    int send_in_chunks(const std::string& method_name, const std::string& selector,
+                       uint64 gas_per_op, size_t count,
+                       const std::function<std::string(size_t, size_t)>& encode_chunk,
+                       size_t max_chunk_size = SIZE_MAX,
+                       const std::function<Access_key(size_t)>& key_at = nullptr,
+                       bool split = true);
+
+    static bool use_access_lists; // attach EIP-2930 access lists to sent transactions
+
+   protected:
     std::string _store_contract_address;
     std::string _from_address;
     std::string _connection_string;
     size_t max_waiting_time;
+    Fee_config fee_config;
+    int layout; // storage layout of store contract, see STORE_LAYOUT
+    uint32_t table_id; // only for STORE_LAYOUT_MULTI
     CURL *curl;
     std::mutex curl_call_mtx;
+    std::vector<Pending_transaction> submitted_transactions;
+    std::mutex submitted_transactions_mtx;
     static std::mutex nonce_init_mtx;
     static std::atomic_uint64_t nonce;
+    static Gas_model gas_model;
 
     std::vector <std::string> table_scan_call();
+    uint64 get_block_gas_limit();
+    uint64 gas_per_put_op();
+    std::string build_access_list(const std::vector<Access_key>& keys);
+    std::string create_access_list(RPC_params& params);
+    std::string gas_model_key(const std::string& selector);
+    std::string store_function(const std::string& selector);
+    size_t store_head_size();
+    uint64 estimate_gas(RPC_params& params);
+    int submit_apply_batch(std::vector<Batch_op> * data, TXID txID, bool split);
+    void set_fees(RPC_params& params);
+    void replace_transaction(Pending_transaction& transaction, size_t waited);
+    bool is_mined(Pending_transaction& transaction, bool& failed, bool& out_of_gas);
+    bool resend_with_estimate(Pending_transaction& transaction, size_t waited);
+    size_t max_ops_per_transaction(uint64 gas_per_op);
     static size_t get_table_scan_results_size(std::vector<std::string> response);
 };
 
+// Event topics of KVLog
+#define LOG_EVENT_OPS "0x5edddfdc5c6df3b917be732d56715ba238cf26b5d3add3e4a48cb842958b8bac"    // Ops(bytes16,bytes)
+#define LOG_EVENT_COMMIT "0x80826dd0d9a4a3defa19eee3ea47907e446a1b8ca411e9a6aa88562d0f172a56" // Commit(bytes16)
+#define LOG_EVENT_CLEAN "0x95f49f80cdc1754a51a9ee47e67cd09152235e7cddfce3811aaac3e77981cfa3"  // Clean(bytes16)
+#define LOG_SYNC_INTERVAL 1000     // ms, min. time between syncs of a table (writes of this server force one)
+#define LOG_SYNC_PAGE_BLOCKS 2000  // max. block range of one eth_getLogs call (node limits, response size)
+#define LOG_REORG_DEPTH 64         // blocks whose changes can be undone after a reorg
+
+struct Block_header {
+  uint64 number;
+  std::string hash;        // empty if the block does not exist
+  std::string parent_hash;
+};
+
+/*
+ * Table stored in a log store contract (KVLog): writes are only emitted as event logs,
+ * reads are served from table state materialized locally from these logs (no contract calls).
+ */
+class Ethereum_log : public Ethereum {
+
+public:
+    explicit Ethereum_log(std::string connection_string,
+                          std::string store_contract_address,
+                          std::string from_address,
+                          int max_waiting_time,
+                          Fee_config fee_config,
+                          uint64 first_block = 0);
+
+    int get(Byte_data* key, unsigned char* buf, int value_size) override;
+    int put(Byte_data* key, Byte_data* value, TXID txID) override;
+    int remove(Byte_data *key, TXID txID) override;
+    int submit_put_batch(std::vector<Put_op> * data, TXID txID) override;
+    int submit_remove_batch(std::vector<Remove_op> * data, TXID txID) override;
+    int submit_apply_batch(std::vector<Batch_op> * data, TXID txID) override;
+    int apply_single_transaction(std::vector<Batch_op> * data) override;
+    void table_scan_to_vec(std::vector<Managed_byte_data> &tuples, size_t key_length, size_t value_length) override;
+    void table_scan_to_map(tx_cache_t& tuples, size_t key_kength, size_t value_length) override;
+    int wait_for_submitted() override;
+
+   private:
+    std::shared_ptr<Log_table_state> state;
+    uint64 first_block; // deployment block of the store contract, 0: looked up
+
+    void sync();
+    bool sync_page(uint64 from_block, uint64 to_block);
+    bool undo_reorg(const Block_header& latest);
+    uint64 find_deployment_block(uint64 latest);
+};
+
+/*
+ * Table stored off-chain in a local journal (see Rollup_state): commits return once the
+ * operations are journaled. Batches of changes are published to the rollup contract
+ * (KVRollup) periodically, as Merkle root and diff.
+ */
+class Ethereum_rollup : public Ethereum {
+
+public:
+    explicit Ethereum_rollup(std::string connection_string,
+                             std::string store_contract_address,
+                             std::string from_address,
+                             int max_waiting_time,
+                             Fee_config fee_config);
+
+    int get(Byte_data* key, unsigned char* buf, int value_size) override;
+    int put(Byte_data* key, Byte_data* value, TXID txID) override;
+    int put_batch(std::vector<Put_op> * data, TXID txID) override;
+    int remove(Byte_data *key, TXID txID) override;
+    int remove_batch(std::vector<Remove_op> * data, TXID txID) override;
+    int submit_put_batch(std::vector<Put_op> * data, TXID txID) override;
+    int submit_remove_batch(std::vector<Remove_op> * data, TXID txID) override;
+    int apply_batch(std::vector<Batch_op> * data, TXID txID) override;
+    int submit_apply_batch(std::vector<Batch_op> * data, TXID txID) override;
+    int apply_single_transaction(std::vector<Batch_op> * data) override;
+    void table_scan_to_vec(std::vector<Managed_byte_data> &tuples, size_t key_length, size_t value_length) override;
+    void table_scan_to_map(tx_cache_t& tuples, size_t key_kength, size_t value_length) override;
+    int clear_commit_prepare(boost::uuids::uuid tx_ID) override;
+
+    static int commit_prepared(const Table_contract& contract, TXID tx_ID);
+
+    static int batch_interval; // seconds between published batches
+    static void stop_publishers(); // at plugin deinit, joins the publisher threads
+
+   private:
+    std::shared_ptr<Rollup_state> state;
+
+    int write(std::vector<Rollup_state::Op>&& ops, TXID txID);
+};
+
 #endif  // MYSQL_8_0_20_ETHEREUM_H
@@ -0,0 +1,62 @@
+#include "gas_model.h"
+
+#include <algorithm>
+
+uint64_t Gas_model::predict(const std::string& selector, size_t op_count, uint64_t gas_per_op_bound) {
+  std::lock_guard<std::mutex> lock(stats_mtx);
+
+  auto entry = stats.find(selector);
+  if(entry == stats.end()) {
+    return gas_per_op_bound == 0 ? 0 : (uint64_t) ((TX_BASE_GAS + gas_per_op_bound * op_count) * GAS_SAFETY_MARGIN);
+  }
+
+  auto& selector_stats = entry->second;
+  uint64_t gas = TX_BASE_GAS + std::max(selector_stats.max_gas_per_op, gas_per_op_bound) * op_count;
+
+  // An observation for exactly this operation count may be higher (e.g. larger table)
+  auto exact = selector_stats.gas_by_op_count.find(op_count);
+  if(exact != selector_stats.gas_by_op_count.end()) {
+    gas = std::max(gas, exact->second);
+  }
+
+  return (uint64_t) (gas * GAS_SAFETY_MARGIN);
+}
+
+uint64_t Gas_model::gas_per_op(const std::string& selector, uint64_t prior) {
+  std::lock_guard<std::mutex> lock(stats_mtx);
+
+  auto entry = stats.find(selector);
+  if(entry == stats.end()) {
+    return prior;
+  }
+
+  return std::max(prior, (uint64_t) (entry->second.max_gas_per_op * GAS_SAFETY_MARGIN));
+}
+
+void Gas_model::observe_estimate(const std::string& selector, size_t op_count, uint64_t gas) {
+  observe(selector, op_count, gas);
+}
+
+void Gas_model::observe_receipt(const std::string& selector, size_t op_count, uint64_t gas_used) {
+  observe(selector, op_count, (uint64_t) (gas_used * GAS_REFUND_ALLOWANCE));
+}
+
+void Gas_model::observe_out_of_gas(const std::string& selector, size_t op_count, uint64_t gas_limit) {
+  // Real demand is unknown, but above the limit (the retry with eth_estimateGas reports it)
+  observe(selector, op_count, gas_limit);
+}
+
+void Gas_model::observe(const std::string& selector, size_t op_count, uint64_t gas) {
+  if(op_count == 0) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(stats_mtx);
+  auto& selector_stats = stats[selector];
+
+  auto& known_gas = selector_stats.gas_by_op_count[op_count];
+  known_gas = std::max(known_gas, gas);
+
+  uint64_t per_op = gas > TX_BASE_GAS ? (gas - TX_BASE_GAS + op_count - 1) / op_count : 0;
+  selector_stats.max_gas_per_op = std::max(selector_stats.max_gas_per_op, per_op);
+}
@@ -0,0 +1,54 @@
+#ifndef MYSQL_8_0_20_GAS_MODEL_H
+#define MYSQL_8_0_20_GAS_MODEL_H
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#define TX_BASE_GAS 21000           // intrinsic gas of every transaction
+#define GAS_SAFETY_MARGIN 1.1       // gas limit = predicted gas * margin
+#define GAS_REFUND_ALLOWANCE 1.25   // receipts report gas after refunds (max. 1/5 of gas used)
+
+/*
+ * Learns the gas needed by contract functions, keyed by function selector and number of
+ * operations in the transaction (e.g. number of keys of a putBatch). Observations come
+ * from eth_estimateGas results and from the gasUsed field of transaction receipts.
+ *
+ * For each selector, the maximum observed gas per operation count is kept, so limits only
+ * grow if the contract needs more gas (e.g. for bigger tables), but stay tight otherwise.
+ * Gas of store functions depends on contract state (overwriting a key is cheaper than
+ * adding one), so a prediction never goes below the per-operation upper bound of the caller.
+ * Shared between all Ethereum connectors, since all tables use the same contract code.
+ */
+class Gas_model {
+ public:
+  /*
+   * Returns the gas limit to use (including safety margin), at least for op_count times
+   * gas_per_op_bound (e.g. cost of new keys). 0 if the selector is unknown and there is no bound
+   */
+  uint64_t predict(const std::string& selector, size_t op_count, uint64_t gas_per_op_bound);
+
+  /*
+   * Returns the gas needed per operation, at least prior (upper bound of the caller)
+   */
+  uint64_t gas_per_op(const std::string& selector, uint64_t prior);
+
+  void observe_estimate(const std::string& selector, size_t op_count, uint64_t gas);
+  void observe_receipt(const std::string& selector, size_t op_count, uint64_t gas_used);
+  void observe_out_of_gas(const std::string& selector, size_t op_count, uint64_t gas_limit);
+
+ private:
+  struct Selector_stats {
+    std::map<size_t, uint64_t> gas_by_op_count;
+    uint64_t max_gas_per_op = 0;
+  };
+
+  std::unordered_map<std::string, Selector_stats> stats;
+  std::mutex stats_mtx;
+
+  void observe(const std::string& selector, size_t op_count, uint64_t gas);
+};
+
+#endif  // MYSQL_8_0_20_GAS_MODEL_H
@@ -0,0 +1,96 @@
+#include "keccak.h"
+
+#include <cstring>
+
+#define KECCAK_ROUNDS 24
+#define KECCAK_256_RATE 136 // bytes absorbed per permutation: (1600 - 2 * 256) / 8
+
+static const uint64_t round_constants[KECCAK_ROUNDS] = {
+  0x0000000000000001ULL, 0x0000000000008082ULL, 0x800000000000808AULL, 0x8000000080008000ULL,
+  0x000000000000808BULL, 0x0000000080000001ULL, 0x8000000080008081ULL, 0x8000000000008009ULL,
+  0x000000000000008AULL, 0x0000000000000088ULL, 0x0000000080008009ULL, 0x000000008000000AULL,
+  0x000000008000808BULL, 0x800000000000008BULL, 0x8000000000008089ULL, 0x8000000000008003ULL,
+  0x8000000000008002ULL, 0x8000000000000080ULL, 0x000000000000800AULL, 0x800000008000000AULL,
+  0x8000000080008081ULL, 0x8000000000008080ULL, 0x0000000080000001ULL, 0x8000000080008008ULL
+};
+
+// rotation offsets and lane order of the combined rho and pi steps
+static const int rotations[24] = {
+  1, 3, 6, 10, 15, 21, 28, 36, 45, 55, 2, 14, 27, 41, 56, 8, 25, 43, 62, 18, 39, 61, 20, 44
+};
+static const int pi_lanes[24] = {
+  10, 7, 11, 17, 18, 3, 5, 16, 8, 21, 24, 4, 15, 23, 19, 13, 12, 2, 20, 14, 22, 9, 6, 1
+};
+
+static inline uint64_t rotl(uint64_t x, int n) {
+  return (x << n) | (x >> (64 - n));
+}
+
+static void keccak_f(uint64_t state[25]) {
+  uint64_t c[5];
+
+  for(int round = 0; round < KECCAK_ROUNDS; round++) {
+    // theta
+    for(int x = 0; x < 5; x++) {
+      c[x] = state[x] ^ state[x + 5] ^ state[x + 10] ^ state[x + 15] ^ state[x + 20];
+    }
+    for(int x = 0; x < 5; x++) {
+      uint64_t d = c[(x + 4) % 5] ^ rotl(c[(x + 1) % 5], 1);
+      for(int y = 0; y < 25; y += 5) {
+        state[y + x] ^= d;
+      }
+    }
+
+    // rho and pi
+    uint64_t current = state[1];
+    for(int i = 0; i < 24; i++) {
+      int lane = pi_lanes[i];
+      uint64_t next = state[lane];
+      state[lane] = rotl(current, rotations[i]);
+      current = next;
+    }
+
+    // chi
+    for(int y = 0; y < 25; y += 5) {
+      for(int x = 0; x < 5; x++) {
+        c[x] = state[y + x];
+      }
+      for(int x = 0; x < 5; x++) {
+        state[y + x] = c[x] ^ ((~c[(x + 1) % 5]) & c[(x + 2) % 5]);
+      }
+    }
+
+    // iota
+    state[0] ^= round_constants[round];
+  }
+}
+
+static void absorb(uint64_t state[25], const uint8_t* block) {
+  for(int i = 0; i < KECCAK_256_RATE / 8; i++) {
+    uint64_t lane = 0;
+    for(int b = 7; b >= 0; b--) {
+      lane = (lane << 8) | block[8 * i + b]; // lanes are little endian
+    }
+    state[i] ^= lane;
+  }
+  keccak_f(state);
+}
+
+void keccak_256(const uint8_t* data, size_t length, uint8_t* out) {
+  uint64_t state[25] = {0};
+
+  for(; length >= KECCAK_256_RATE; length -= KECCAK_256_RATE, data += KECCAK_256_RATE) {
+    absorb(state, data);
+  }
+
+  // last block with Keccak padding (0x01 ... 0x80)
+  uint8_t block[KECCAK_256_RATE] = {0};
+  memcpy(block, data, length);
+  block[length] |= 0x01;
+  block[KECCAK_256_RATE - 1] |= 0x80;
+  absorb(state, block);
+
+  for(int i = 0; i < 32; i++) {
+    out[i] = (uint8_t) (state[i / 8] >> (8 * (i % 8)));
+  }
+}
@@ -0,0 +1,13 @@
+#ifndef MYSQL_8_0_20_KECCAK_H
+#define MYSQL_8_0_20_KECCAK_H
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Keccak-256 as used by Ethereum (original Keccak padding, not SHA3-256),
+ * e.g. to compute storage slots of mapping entries: keccak256(key . slot)
+ */
+void keccak_256(const uint8_t* data, size_t length, uint8_t* out);
+
+#endif  // MYSQL_8_0_20_KECCAK_H
@@ -0,0 +1,95 @@
+#include "log_table_state.h"
+
+std::shared_ptr<Log_table_state> Log_table_state::get(const std::string& contract_address) {
+  static std::unordered_map<std::string, std::shared_ptr<Log_table_state>> states;
+  static std::mutex states_mtx;
+
+  std::lock_guard<std::mutex> lock(states_mtx);
+  auto& state = states[contract_address];
+  if(state == nullptr) {
+    state = std::make_shared<Log_table_state>();
+  }
+
+  return state;
+}
+
+void Log_table_state::append(const std::string& tx_id, std::vector<Op>&& ops, uint64_t block) {
+  if(tx_id.empty()) {
+    apply(ops, block);
+    return;
+  }
+
+  auto& buffered = pending[tx_id];
+  Undo undo{block, UNDO_PENDING_SIZE, tx_id, true, {}, buffered.size(), {}};
+  undo_log.push_back(std::move(undo));
+  buffered.insert(buffered.end(), std::make_move_iterator(ops.begin()), std::make_move_iterator(ops.end()));
+}
+
+void Log_table_state::commit(const std::string& tx_id, uint64_t block) {
+  auto entry = pending.find(tx_id);
+  if(entry == pending.end()) {
+    return;
+  }
+
+  save_pending(tx_id, block);
+  apply(entry->second, block);
+  pending.erase(entry);
+}
+
+void Log_table_state::clean(const std::string& tx_id, uint64_t block) {
+  if(pending.find(tx_id) == pending.end()) {
+    return;
+  }
+
+  save_pending(tx_id, block);
+  pending.erase(tx_id);
+}
+
+void Log_table_state::rollback(uint64_t block) {
+  while(!undo_log.empty() && undo_log.back().block >= block) {
+    Undo& undo = undo_log.back();
+    if(undo.type == UNDO_ROW) {
+      if(undo.existed) {
+        rows[undo.key] = std::move(undo.row);
+      } else {
+        rows.erase(undo.key);
+      }
+    } else if(undo.type == UNDO_PENDING_SIZE) {
+      auto& buffered = pending[undo.key];
+      buffered.resize(undo.size);
+      if(buffered.empty()) pending.erase(undo.key);
+    } else {
+      pending[undo.key] = std::move(undo.ops);
+    }
+    undo_log.pop_back();
+  }
+}
+
+void Log_table_state::confirm(uint64_t block) {
+  while(!undo_log.empty() && undo_log.front().block < block) {
+    undo_log.pop_front();
+  }
+}
+
+/*
+ * Buffered operations of tx_id are applied or dropped: keeps a copy for rollback()
+ */
+void Log_table_state::save_pending(const std::string& tx_id, uint64_t block) {
+  Undo undo{block, UNDO_PENDING_OPS, tx_id, true, {}, 0, pending[tx_id]};
+  undo_log.push_back(std::move(undo));
+}
+
+void Log_table_state::apply(std::vector<Op>& ops, uint64_t block) {
+  for(auto& op : ops) {
+    auto row = rows.find(op.key);
+    Undo undo{block, UNDO_ROW, op.key, row != rows.end(), {}, 0, {}};
+    if(undo.existed) undo.row = row->second;
+    undo_log.push_back(std::move(undo));
+
+    if(op.remove) {
+      rows.erase(op.key);
+    } else {
+      rows[op.key] = Row{std::move(op.value), block};
+    }
+  }
+}
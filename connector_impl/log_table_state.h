@@ -0,0 +1,94 @@
+#ifndef MYSQL_8_0_20_LOG_TABLE_STATE_H
+#define MYSQL_8_0_20_LOG_TABLE_STATE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Table state materialized from the event log of a log store contract (KVLog, see
+ * LogStorage.sol). Shared by all connectors of a table and synced incrementally: logs of
+ * blocks [first block, next_block) are applied, starting at the deployment block of the contract.
+ *
+ * Changes from blocks that can still be reorged out (the last LOG_REORG_DEPTH blocks) are
+ * recorded in an undo log, see rollback(). The sync detects reorgs by the hashes of the blocks
+ * it synced up to (block_hashes).
+ *
+ * Keys and values are padded with zeros to 32 bytes, as in the store contracts.
+ * Not thread safe, callers hold mtx. The sync holds sync_mtx while it calls the node and
+ * mtx only while it applies the fetched logs, so reads are not blocked by the RPCs.
+ */
+class Log_table_state {
+ public:
+  struct Op {
+    std::string key;
+    std::string value; // empty for removes
+    bool remove;
+  };
+
+  struct Row {
+    std::string value;
+    uint64_t block; // block of last write
+  };
+
+  static std::shared_ptr<Log_table_state> get(const std::string& contract_address);
+
+  /*
+   * Applies operations directly (tx_id empty) or buffers them until commit of tx_id
+   */
+  void append(const std::string& tx_id, std::vector<Op>&& ops, uint64_t block);
+  void commit(const std::string& tx_id, uint64_t block);
+  void clean(const std::string& tx_id, uint64_t block);
+
+  /*
+   * Undoes the changes of blocks >= block (reorged out)
+   */
+  void rollback(uint64_t block);
+
+  /*
+   * Drops the undo of blocks < block (final)
+   */
+  void confirm(uint64_t block);
+
+  std::mutex mtx;
+  std::unordered_map<std::string, Row> rows;
+
+  std::mutex sync_mtx;
+  bool started{false};                             // guarded by sync_mtx, next_block set to first block
+  uint64_t next_block{0};                          // guarded by sync_mtx
+  std::map<uint64_t, std::string> block_hashes;    // guarded by sync_mtx, hashes of synced blocks
+  std::chrono::steady_clock::time_point last_sync; // guarded by sync_mtx
+  std::atomic_bool written{false};                 // write of this server sent, next read syncs
+
+ private:
+  enum UNDO_TYPE {
+    UNDO_ROW,            // restore row key (or erase it)
+    UNDO_PENDING_SIZE,   // truncate buffered operations of transaction key
+    UNDO_PENDING_OPS     // restore buffered operations of transaction key (or erase them)
+  };
+
+  struct Undo {
+    uint64_t block;
+    int type;
+    std::string key;
+    bool existed;
+    Row row;
+    size_t size;
+    std::vector<Op> ops;
+  };
+
+  std::unordered_map<std::string, std::vector<Op>> pending; // buffered operations by transaction id
+  std::deque<Undo> undo_log;
+
+  void apply(std::vector<Op>& ops, uint64_t block);
+  void save_pending(const std::string& tx_id, uint64_t block);
+};
+
+#endif  // MYSQL_8_0_20_LOG_TABLE_STATE_H
@@ -0,0 +1,238 @@
+#include "rollup_state.h"
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+#include "keccak.h"
+
+#define ROLLUP_RECORD_OPS 'O'      // committed operations: (removed, key, value) each
+#define ROLLUP_RECORD_BATCH 'B'    // published batch: journal offset covered by it
+#define ROLLUP_RECORD_SNAPSHOT 'S' // rows at compaction, encoded as operations (first record only)
+#define ROLLUP_OP_SIZE 65
+#define ROLLUP_JOURNAL_MIN_COMPACT (1024 * 1024) // smaller journals are not compacted
+
+std::shared_ptr<Rollup_state> Rollup_state::get(const std::string& contract_address) {
+  static std::unordered_map<std::string, std::shared_ptr<Rollup_state>> states;
+  static std::mutex states_mtx;
+
+  std::lock_guard<std::mutex> lock(states_mtx);
+  auto& state = states[contract_address];
+  if(state == nullptr) {
+    state = std::make_shared<Rollup_state>();
+    // relative to data directory of the server
+    state->open_journal("bc_rollup_" + contract_address + ".journal");
+  }
+
+  return state;
+}
+
+static void encode_op(std::string& payload, const Rollup_state::Op& op) {
+  payload.push_back(op.remove ? 1 : 0);
+  payload.append(op.key);
+  payload.append(op.remove ? std::string(32, 0) : op.value);
+}
+
+static std::vector<Rollup_state::Op> decode_ops(const char* payload, uint32_t length) {
+  std::vector<Rollup_state::Op> ops;
+  ops.reserve(length / ROLLUP_OP_SIZE);
+  for(size_t i = 0; i + ROLLUP_OP_SIZE <= length; i += ROLLUP_OP_SIZE) {
+    bool remove = payload[i] != 0;
+    ops.push_back(Rollup_state::Op{std::string(payload + i + 1, 32),
+                                   remove ? "" : std::string(payload + i + 33, 32), remove});
+  }
+  return ops;
+}
+
+void Rollup_state::open_journal(const std::string& path) {
+  // Replay journal, operations after the last published batch are the diff of the next one.
+  // Only records not covered by a published batch are kept.
+  std::vector<std::pair<uint64_t, std::vector<Op>>> records;
+  uint64_t batch_offset = 0;
+  journal.open(path, [&](char type, const char* payload, uint32_t length, uint64_t offset) {
+    if(type == ROLLUP_RECORD_OPS || type == ROLLUP_RECORD_SNAPSHOT) {
+      std::vector<Op> ops = decode_ops(payload, length);
+      for(auto& op : ops) {
+        apply(op);
+      }
+      if(type == ROLLUP_RECORD_OPS) {
+        records.emplace_back(offset, std::move(ops));
+      }
+    } else if(type == ROLLUP_RECORD_BATCH && length == 8) {
+      memcpy(&batch_offset, payload, 8);
+      records.erase(std::remove_if(records.begin(), records.end(),
+                                   [batch_offset](const std::pair<uint64_t, std::vector<Op>>& record) {
+                                     return record.first < batch_offset;
+                                   }),
+                    records.end());
+    }
+    return true;
+  });
+
+  for(auto& record : records) {
+    for(auto& op : record.second) {
+      diff[op.key] = op;
+    }
+  }
+}
+
+void Rollup_state::apply(const Op& op) {
+  if(op.remove) {
+    rows.erase(op.key);
+  } else {
+    rows[op.key] = op.value;
+  }
+}
+
+int Rollup_state::commit(std::vector<Op>&& ops) {
+  std::string payload;
+  payload.reserve(ops.size() * ROLLUP_OP_SIZE);
+  for(auto& op : ops) {
+    encode_op(payload, op);
+  }
+
+  std::lock_guard<std::mutex> lock(mtx);
+  if(journal.append(ROLLUP_RECORD_OPS, payload) != 0) {
+    return 1;
+  }
+
+  for(auto& op : ops) {
+    apply(op);
+    diff[op.key] = std::move(op);
+  }
+
+  return 0;
+}
+
+void Rollup_state::prepare(const std::string& tx_id, std::vector<Op>&& ops) {
+  std::lock_guard<std::mutex> lock(mtx);
+  auto& buffered = pending[tx_id];
+  buffered.insert(buffered.end(), std::make_move_iterator(ops.begin()), std::make_move_iterator(ops.end()));
+}
+
+int Rollup_state::commit_prepared(const std::string& tx_id) {
+  std::vector<Op> ops;
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    auto entry = pending.find(tx_id);
+    if(entry == pending.end()) {
+      return 0;
+    }
+    ops = std::move(entry->second);
+    pending.erase(entry);
+  }
+
+  return commit(std::move(ops));
+}
+
+void Rollup_state::clean(const std::string& tx_id) {
+  std::lock_guard<std::mutex> lock(mtx);
+  pending.erase(tx_id);
+}
+
+bool Rollup_state::take_batch(std::vector<Op>& batch, uint64_t& journal_offset) {
+  std::lock_guard<std::mutex> lock(mtx);
+  if(batch_in_flight || diff.empty()) {
+    return false;
+  }
+
+  batch.reserve(diff.size());
+  for(auto& entry : diff) {
+    batch.emplace_back(std::move(entry.second));
+  }
+  diff.clear();
+
+  journal_offset = journal.size();
+  batch_in_flight = true;
+  return true;
+}
+
+int Rollup_state::batch_published(uint64_t journal_offset) {
+  std::lock_guard<std::mutex> lock(mtx);
+  batch_in_flight = false;
+  if(journal.append(ROLLUP_RECORD_BATCH, std::string(reinterpret_cast<const char*>(&journal_offset), 8)) != 0) {
+    return 1;
+  }
+
+  if(journal.size() > ROLLUP_JOURNAL_MIN_COMPACT && journal.size() > 2 * (rows.size() + diff.size()) * ROLLUP_OP_SIZE) {
+    compact_journal();
+  }
+  return 0;
+}
+
+/*
+ * Replaces the journal by a snapshot of the rows followed by the unpublished operations (the
+ * diff, last operation per key, so replaying it over the snapshot changes nothing). Until the
+ * rename, the old journal remains valid. Caller holds mtx, no batch is in flight.
+ */
+void Rollup_state::compact_journal() {
+  std::string snapshot;
+  snapshot.reserve(rows.size() * ROLLUP_OP_SIZE);
+  for(auto& row : rows) {
+    encode_op(snapshot, Op{row.first, row.second, false});
+  }
+
+  std::string unpublished;
+  unpublished.reserve(diff.size() * ROLLUP_OP_SIZE);
+  for(auto& entry : diff) {
+    encode_op(unpublished, entry.second);
+  }
+
+  std::string records = Journal_file::encode_record(ROLLUP_RECORD_SNAPSHOT, snapshot);
+  if(!unpublished.empty()) {
+    records.append(Journal_file::encode_record(ROLLUP_RECORD_OPS, unpublished));
+  }
+  journal.rewrite(records);
+}
+
+void Rollup_state::batch_failed(std::vector<Op>& batch) {
+  std::lock_guard<std::mutex> lock(mtx);
+  batch_in_flight = false;
+
+  // operations committed in the meantime are newer
+  for(auto& op : batch) {
+    diff.emplace(op.key, std::move(op));
+  }
+}
+
+bool Rollup_state::start_publisher() {
+  std::lock_guard<std::mutex> lock(mtx);
+  bool first = !publisher_started;
+  publisher_started = true;
+  return first;
+}
+
+std::string Rollup_state::merkle_root(const std::vector<Op>& batch) {
+  std::vector<std::string> level;
+  level.reserve(batch.size());
+  for(auto& op : batch) {
+    std::string leaf;
+    encode_op(leaf, op);
+    std::string hash(32, 0);
+    keccak_256(reinterpret_cast<const uint8_t*>(leaf.data()), leaf.size(), reinterpret_cast<uint8_t*>(&hash[0]));
+    level.emplace_back(std::move(hash));
+  }
+
+  if(level.empty()) {
+    return std::string(32, 0);
+  }
+
+  // Inner nodes hash the sorted pair, an odd node is moved up unchanged
+  while(level.size() > 1) {
+    std::vector<std::string> next;
+    for(size_t i = 0; i < level.size(); i += 2) {
+      if(i + 1 == level.size()) {
+        next.emplace_back(std::move(level[i]));
+        continue;
+      }
+
+      std::string pair = std::min(level[i], level[i + 1]) + std::max(level[i], level[i + 1]);
+      std::string hash(32, 0);
+      keccak_256(reinterpret_cast<const uint8_t*>(pair.data()), pair.size(), reinterpret_cast<uint8_t*>(&hash[0]));
+      next.emplace_back(std::move(hash));
+    }
+    level.swap(next);
+  }
+
+  return level[0];
+}
@@ -0,0 +1,77 @@
+#ifndef MYSQL_8_0_20_ROLLUP_STATE_H
+#define MYSQL_8_0_20_ROLLUP_STATE_H
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <storage/blockchain/journal_file.h>
+
+#include "log_table_state.h"
+
+/*
+ * Rows of a rollup table (KVRollup, see RollupStorage.sol), stored locally. Committed
+ * operations are appended to a journal file (fsynced) and collected in the diff of the next
+ * batch, which is published to the store contract periodically. The journal is replayed
+ * when the state is created, operations after the last published batch form the diff again.
+ * After a published batch, a journal that has grown beyond twice the size of the rows is
+ * replaced by a snapshot of the rows and the unpublished operations (see compact_journal).
+ *
+ * Keys and values are padded with zeros to 32 bytes. Readers of rows hold mtx.
+ */
+class Rollup_state {
+ public:
+  using Op = Log_table_state::Op;
+
+  static std::shared_ptr<Rollup_state> get(const std::string& contract_address);
+
+  /*
+   * Journals and applies operations, returns 0 on success, 1 on failure
+   */
+  int commit(std::vector<Op>&& ops);
+
+  /*
+   * Operations of transaction tx_id are journaled when the transaction is committed
+   */
+  void prepare(const std::string& tx_id, std::vector<Op>&& ops);
+  int commit_prepared(const std::string& tx_id);
+  void clean(const std::string& tx_id);
+
+  /*
+   * Takes the diff since the last batch (last operation per key, sorted by key) if no other
+   * batch is being published. journal_offset: end of the journal covered by the batch
+   */
+  bool take_batch(std::vector<Op>& batch, uint64_t& journal_offset);
+  int batch_published(uint64_t journal_offset);
+  void batch_failed(std::vector<Op>& batch);
+
+  /*
+   * Root of the Merkle tree over the (sorted) diff, leaves: keccak256(removed . key . value)
+   */
+  static std::string merkle_root(const std::vector<Op>& batch);
+
+  /*
+   * Returns true only for the first caller, who starts the publisher of batches
+   */
+  bool start_publisher();
+
+  std::mutex mtx;
+  std::unordered_map<std::string, std::string> rows;
+
+ private:
+  Journal_file journal{"rollup journal"};
+  std::map<std::string, Op> diff; // operations since last batch, by key
+  bool batch_in_flight{false};
+  bool publisher_started{false};
+  std::unordered_map<std::string, std::vector<Op>> pending; // prepared operations by transaction id
+
+  void open_journal(const std::string& path);
+  void compact_journal();
+  void apply(const Op& op);
+};
+
+#endif  // MYSQL_8_0_20_ROLLUP_STATE_H
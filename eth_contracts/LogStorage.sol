@@ -0,0 +1,45 @@
+pragma solidity ^0.8.0;
+
+/// @title Append-only log of table operations, without contract storage
+/// @dev Operations are only emitted as events, the storage engine materializes the table
+///  state from the logs. Encoding of ops, for each operation: key length (1 byte, highest
+///  bit set for removes), key and, for puts, value length (1 byte), value.
+///  commit/clean have the same interface as in KVStore, so Transaction.commitAll works.
+contract KVLog {
+
+    event Ops(bytes16 indexed txId, bytes ops); // txId 0: operations are applied directly
+    event Commit(bytes16 indexed txId);
+    event Clean(bytes16 indexed txId);
+
+    function append(
+        bytes calldata ops)
+    external
+    {
+        emit Ops(0, ops);
+    }
+
+    /// Operations are applied when the transaction is committed
+    function append(
+        bytes calldata ops,
+        bytes16 txId)
+    external
+    {
+        require(txId != 0);
+        emit Ops(txId, ops);
+    }
+
+    function commit(
+        bytes16 txId)
+    external
+    {
+        emit Commit(txId);
+    }
+
+    function clean(
+        bytes16 txId)
+    external
+    {
+        emit Clean(txId);
+    }
+
+}
@@ -0,0 +1,57 @@
+pragma solidity ^0.8.0;
+
+/// @title Merkle roots of table state diffs, rows are stored off-chain
+/// @dev The storage engine keeps the rows in a local journal and periodically submits a batch:
+///  the Merkle root of the diff (changes since the previous batch, last write per key) and
+///  the diff itself as calldata (same encoding as KVLog ops). Leaves are
+///  keccak256(removed . key . value), sorted by key, inner nodes hash the sorted pair.
+///  A diff that does not fit into one transaction is submitted as several batches (chunks of
+///  the sorted diff, each with its own root).
+///
+///  Proofs for verify() are derived from the diff in the Batch event of the batch (the journal
+///  bc_rollup_<address>.journal holds the same operations, but not the chunk boundaries):
+///  hash the leaves of the diff in order, then build the tree level by level, pairing
+///  neighbours (an odd last node moves up unchanged). The proof of a leaf is the list of its
+///  siblings from the leaf level up to the root (levels where it has no sibling are skipped).
+contract KVRollup {
+
+    bytes32[] public roots;
+
+    event Batch(uint256 indexed number, bytes32 root, bytes diff);
+
+    function submitBatch(
+        bytes32 root,
+        bytes calldata diff)
+    external
+    {
+        roots.push(root);
+        emit Batch(roots.length - 1, root, diff);
+    }
+
+    function batchCount()
+    external view
+    returns (uint256)
+    {
+        return roots.length;
+    }
+
+    /// Proves that the row was written (or removed) by the given batch
+    function verify(
+        uint256 batch,
+        bytes32 key,
+        bytes32 value,
+        bool removed,
+        bytes32[] calldata proof)
+    external view
+    returns (bool)
+    {
+        bytes32 node = keccak256(abi.encodePacked(removed, key, value));
+        for (uint256 i = 0; i < proof.length; i++) {
+            node = node < proof[i]
+                ? keccak256(abi.encodePacked(node, proof[i]))
+                : keccak256(abi.encodePacked(proof[i], node));
+        }
+        return node == roots[batch];
+    }
+
+}
@@ -19,6 +19,7 @@ contract KVStore {
 
     mapping(bytes32 => Value) private data;         // data store
     bytes32[] internal keyList;                     // list of keys of data
+    mapping(bytes32 => uint) private keyIndex;      // position of key in keyList + 1 (0: key not stored)
     mapping(bytes16 => TxOperation[]) private txBuffer; // buffer for transactions: maps transaction id to list of operations
 
     /// Store the pair key:value in the storage.
@@ -34,6 +35,7 @@ contract KVStore {
 
         if(data[key].blocknumber == 0) {
             keyList.push(key);
+            keyIndex[key] = keyList.length;
         }
 
         // persist data in blockchain
@@ -89,6 +91,7 @@ contract KVStore {
 
             if(data[keys[i]].blocknumber == 0) {
                 keyList.push(keys[i]);
+                keyIndex[keys[i]] = keyList.length;
             }
 
             data[keys[i]] = v;
@@ -107,30 +110,83 @@ contract KVStore {
         }
     }
 
-    function remove(
-        bytes32 key)
+    /// Stores multiple key:value pairs, passed in packed encoding to save calldata.
+    /// @param packed For each pair: key length (1 byte), key, value length (1 byte), value;
+    ///  keys and values are padded with zeros to 32 bytes
+    function putBatchPacked(
+        bytes memory packed)
     public
     {
-        // remove from keyList: find index, then swap with last element, then call pop()
-        uint size = keyList.length;
-        uint index = type(uint256).max;
+        uint pos = 0;
+        bytes32 key;
+        bytes32 value;
 
-        for(uint i=0; i<size; i++) {
-            if(keyList[i] == key) {
-                index = i;
-                break;
-            }
+        while (pos < packed.length) {
+            (key, pos) = readPacked(packed, pos);
+            (value, pos) = readPacked(packed, pos);
+            put(key, value);
         }
+    }
+
+    function putBatchPacked(
+        bytes memory packed,
+        bytes16 txId)
+    public
+    {
+        uint pos = 0;
+        bytes32 key;
+        bytes32 value;
+
+        while (pos < packed.length) {
+            (key, pos) = readPacked(packed, pos);
+            (value, pos) = readPacked(packed, pos);
+            txBuffer[txId].push(TxOperation(key, value, false));
+        }
+    }
+
+    /// Reads one length prefixed element of packed at pos, returns it and the position of the next one
+    function readPacked(
+        bytes memory packed,
+        uint pos)
+    private
+    pure
+    returns (bytes32 element, uint next)
+    {
+        uint length;
+        assembly {
+            let p := add(add(packed, 32), pos)
+            length := byte(0, mload(p))
+            // keep first length bytes only
+            element := and(mload(add(p, 1)), not(shr(mul(8, length), not(0))))
+        }
+
+        next = pos + 1 + length;
+        require(length <= 32 && next <= packed.length);
+    }
+
+    function remove(
+        bytes32 key)
+    public
+    {
+        // remove from keyList: look up index, then swap with last element, then call pop()
+        uint position = keyIndex[key];
 
-        if(index == type(uint256).max) {
+        if(position == 0) {
             // key not found
             return;
         }
 
-        keyList[index] = keyList[size - 1]; // move last element to position of key to delete
+        uint index = position - 1;
+        uint last = keyList.length - 1;
+        if(index != last) {
+            bytes32 lastKey = keyList[last];
+            keyList[index] = lastKey; // move last element to position of key to delete
+            keyIndex[lastKey] = position;
+        }
         keyList.pop();
 
         // delete from data
+        delete keyIndex[key];
         delete data[key];
     }
 
@@ -165,6 +221,47 @@ contract KVStore {
         }
     }
 
+    /// Applies puts and removes in their order, all in one (atomic) transaction.
+    /// @param keys An array of keys of all operations
+    /// @param values An array of values, values[i] is ignored if operation i is a remove
+    /// @param deleteBitmap Bit i is set if operation i is a remove (max. 256 operations)
+    function applyBatch(
+        bytes32[] memory keys,
+        bytes32[] memory values,
+        uint256 deleteBitmap)
+    public
+    {
+        require(keys.length <= 256 && keys.length == values.length);
+
+        for (uint i = 0; i < keys.length; i++) {
+            if((deleteBitmap >> i) & 1 == 1) {
+                remove(keys[i]);
+            } else {
+                put(keys[i], values[i]);
+            }
+        }
+    }
+
+    /// Buffers puts and removes of a transaction, keeping their order.
+    /// @param keys An array of keys of all operations
+    /// @param values An array of values, values[i] is ignored if operation i is a remove
+    /// @param deleteBitmap Bit i is set if operation i is a remove (max. 256 operations)
+    function applyBatch(
+        bytes32[] memory keys,
+        bytes32[] memory values,
+        uint256 deleteBitmap,
+        bytes16 txId)
+    public
+    {
+        require(keys.length <= 256 && keys.length == values.length);
+
+        for (uint i = 0; i < keys.length; i++) {
+            bool deleteEntry = (deleteBitmap >> i) & 1 == 1;
+            TxOperation memory v = TxOperation(keys[i], values[i], deleteEntry);
+            txBuffer[txId].push(v);
+        }
+    }
+
     function tableScan()
     public
     view
@@ -0,0 +1,334 @@
+pragma solidity ^0.8.0;
+
+/// @title A key-value storage contract for many tables, namespaced by table id
+/// @dev Same storage layout per table as KVStoreV2 (TableStorageV2.sol). Transactions on
+///  several tables are committed in one internal loop, without calls to other contracts.
+contract KVStoreMulti {
+
+    // tightly packed struct: one slot
+    struct Entry
+    {
+        uint64 blocknumber; // indicates when value was written (0: key not stored)
+        uint192 position;   // position of key in keyList + 1
+    }
+
+    struct TxOperation {
+        bytes32 key;
+        bytes32 value;
+        bool deleteEntry;
+    }
+
+    mapping(uint32 => mapping(bytes32 => Entry)) private entries;   // meta data of stored keys per table
+    mapping(uint32 => mapping(bytes32 => bytes32)) private data;    // data store per table
+    mapping(uint32 => bytes32[]) internal keyLists;                 // list of keys per table
+    mapping(bytes16 => mapping(uint32 => TxOperation[])) private txBuffer; // buffered operations per transaction and table
+
+    function put(
+        uint32 tableId,
+        bytes32 key,
+        bytes32 value)
+    external
+    {
+        _put(tableId, key, value);
+    }
+
+    function put(
+        uint32 tableId,
+        bytes32 key,
+        bytes32 value,
+        bytes16 txId)
+    external
+    {
+        txBuffer[txId][tableId].push(TxOperation(key, value, false));
+    }
+
+    /// Stores multiple key:value pairs, passed in packed encoding to save calldata.
+    /// @param packed For each pair: key length (1 byte), key, value length (1 byte), value;
+    ///  keys and values are padded with zeros to 32 bytes
+    function putBatchPacked(
+        uint32 tableId,
+        bytes calldata packed)
+    external
+    {
+        uint pos = 0;
+        bytes32 key;
+        bytes32 value;
+
+        while (pos < packed.length) {
+            (key, pos) = _readPacked(packed, pos);
+            (value, pos) = _readPacked(packed, pos);
+            _put(tableId, key, value);
+        }
+    }
+
+    function putBatchPacked(
+        uint32 tableId,
+        bytes calldata packed,
+        bytes16 txId)
+    external
+    {
+        TxOperation[] storage buffer = txBuffer[txId][tableId];
+        uint pos = 0;
+        bytes32 key;
+        bytes32 value;
+
+        while (pos < packed.length) {
+            (key, pos) = _readPacked(packed, pos);
+            (value, pos) = _readPacked(packed, pos);
+            buffer.push(TxOperation(key, value, false));
+        }
+    }
+
+    function remove(
+        uint32 tableId,
+        bytes32 key)
+    external
+    {
+        _remove(tableId, key);
+    }
+
+    function remove(
+        uint32 tableId,
+        bytes32 key,
+        bytes16 txId)
+    external
+    {
+        txBuffer[txId][tableId].push(TxOperation(key, 0, true));
+    }
+
+    function removeBatch(
+        uint32 tableId,
+        bytes32[] calldata keys)
+    external
+    {
+        uint length = keys.length;
+        for (uint i = 0; i < length; ) {
+            _remove(tableId, keys[i]);
+            unchecked { ++i; }
+        }
+    }
+
+    function removeBatch(
+        uint32 tableId,
+        bytes32[] calldata keys,
+        bytes16 txId)
+    external
+    {
+        TxOperation[] storage buffer = txBuffer[txId][tableId];
+        uint length = keys.length;
+        for (uint i = 0; i < length; ) {
+            buffer.push(TxOperation(keys[i], 0, true));
+            unchecked { ++i; }
+        }
+    }
+
+    /// Applies puts and removes in their order, all in one (atomic) transaction.
+    /// @param deleteBitmap Bit i is set if operation i is a remove (max. 256 operations)
+    function applyBatch(
+        uint32 tableId,
+        bytes32[] calldata keys,
+        bytes32[] calldata values,
+        uint256 deleteBitmap)
+    external
+    {
+        _applyBatch(tableId, keys, values, deleteBitmap);
+    }
+
+    /// Buffers puts and removes of a transaction, keeping their order.
+    /// @param deleteBitmap Bit i is set if operation i is a remove (max. 256 operations)
+    function applyBatch(
+        uint32 tableId,
+        bytes32[] calldata keys,
+        bytes32[] calldata values,
+        uint256 deleteBitmap,
+        bytes16 txId)
+    external
+    {
+        uint length = keys.length;
+        require(length <= 256 && length == values.length);
+
+        TxOperation[] storage buffer = txBuffer[txId][tableId];
+        for (uint i = 0; i < length; ) {
+            buffer.push(TxOperation(keys[i], values[i], (deleteBitmap >> i) & 1 == 1));
+            unchecked { ++i; }
+        }
+    }
+
+    /// Applies operations of several tables in one atomic transaction, without buffering them first.
+    /// @param opsPerTable For each table: abi.encode(keys, values, deleteBitmap), see applyBatch
+    function applyAll(
+        uint32[] calldata tableIds,
+        bytes[] calldata opsPerTable)
+    external
+    {
+        uint length = tableIds.length;
+        require(length == opsPerTable.length);
+
+        for (uint i = 0; i < length; ) {
+            (bytes32[] memory keys, bytes32[] memory values, uint256 deleteBitmap) =
+                abi.decode(opsPerTable[i], (bytes32[], bytes32[], uint256));
+            _applyBatch(tableIds[i], keys, values, deleteBitmap);
+            unchecked { ++i; }
+        }
+    }
+
+    /// Commits buffered operations of a transaction on all given tables
+    function commitAll(
+        bytes16 txId,
+        uint32[] calldata tableIds)
+    external
+    {
+        uint tables = tableIds.length;
+        for (uint t = 0; t < tables; ) {
+            uint32 tableId = tableIds[t];
+            TxOperation[] storage values = txBuffer[txId][tableId];
+            uint length = values.length;
+
+            for (uint i = 0; i < length; ) {
+                TxOperation storage op = values[i];
+                if(op.deleteEntry) {
+                    _remove(tableId, op.key);
+                } else {
+                    _put(tableId, op.key, op.value);
+                }
+                unchecked { ++i; }
+            }
+
+            delete txBuffer[txId][tableId];
+            unchecked { ++t; }
+        }
+    }
+
+    function clean(
+        uint32 tableId,
+        bytes16 txId)
+    external
+    {
+        delete txBuffer[txId][tableId];
+    }
+
+    function tableScan(
+        uint32 tableId)
+    external
+    view
+    returns (bytes32[] memory keys, bytes32[] memory values)
+    {
+        bytes32[] storage keyList = keyLists[tableId];
+        mapping(bytes32 => bytes32) storage tableData = data[tableId];
+        uint size = keyList.length;
+        keys = new bytes32[](size);
+        values = new bytes32[](size);
+
+        for(uint i = 0; i < size; ) {
+            bytes32 key = keyList[i];
+            keys[i] = key;
+            values[i] = tableData[key];
+            unchecked { ++i; }
+        }
+
+        return (keys, values);
+    }
+
+    function get(
+        uint32 tableId,
+        bytes32 key)
+    external
+    view
+    returns (bytes32 value, uint blocknumber)
+    {
+        blocknumber = entries[tableId][key].blocknumber;
+
+        // check if KV exists
+        require(blocknumber > 0);
+
+        return (data[tableId][key], blocknumber);
+    }
+
+    function _applyBatch(
+        uint32 tableId,
+        bytes32[] memory keys,
+        bytes32[] memory values,
+        uint256 deleteBitmap)
+    private
+    {
+        uint length = keys.length;
+        require(length <= 256 && length == values.length);
+
+        for (uint i = 0; i < length; ) {
+            if((deleteBitmap >> i) & 1 == 1) {
+                _remove(tableId, keys[i]);
+            } else {
+                _put(tableId, keys[i], values[i]);
+            }
+            unchecked { ++i; }
+        }
+    }
+
+    /// Reads one length prefixed element of packed at pos, returns it and the position of the next one
+    function _readPacked(
+        bytes calldata packed,
+        uint pos)
+    private
+    pure
+    returns (bytes32 element, uint next)
+    {
+        uint length;
+        assembly {
+            let p := add(packed.offset, pos)
+            length := byte(0, calldataload(p))
+            // keep first length bytes only
+            element := and(calldataload(add(p, 1)), not(shr(mul(8, length), not(0))))
+        }
+
+        unchecked { next = pos + 1 + length; }
+        require(length <= 32 && next <= packed.length);
+    }
+
+    /// Writes entry and value slot once; keyList only changes for new keys
+    function _put(
+        uint32 tableId,
+        bytes32 key,
+        bytes32 value)
+    private
+    {
+        Entry memory e = entries[tableId][key];
+
+        if(e.blocknumber == 0) {
+            bytes32[] storage keyList = keyLists[tableId];
+            keyList.push(key);
+            e.position = uint192(keyList.length);
+        }
+
+        e.blocknumber = uint64(block.number);
+        entries[tableId][key] = e;
+        data[tableId][key] = value;
+    }
+
+    /// Swaps key with last element of keyList, then pops it
+    function _remove(
+        uint32 tableId,
+        bytes32 key)
+    private
+    {
+        mapping(bytes32 => Entry) storage tableEntries = entries[tableId];
+        Entry memory e = tableEntries[key];
+
+        if(e.blocknumber == 0) {
+            // key not found
+            return;
+        }
+
+        bytes32[] storage keyList = keyLists[tableId];
+        uint last = keyList.length;
+        if(e.position != last) {
+            bytes32 lastKey = keyList[last - 1];
+            keyList[e.position - 1] = lastKey; // move last element to position of key to delete
+            tableEntries[lastKey].position = e.position;
+        }
+        keyList.pop();
+
+        delete tableEntries[key];
+        delete data[tableId][key];
+    }
+
+}
@@ -0,0 +1,341 @@
+pragma solidity ^0.8.0;
+
+/// @title A key-value storage contract with a batch interface, optimized for gas usage
+/// @dev Same interface as KVStore (TableStorage.sol), but each stored key needs one slot
+///  less: block number and position in keyList share one slot.
+contract KVStoreV2 {
+
+    // tightly packed struct: one slot
+    struct Entry
+    {
+        uint64 blocknumber; // indicates when value was written (0: key not stored)
+        uint192 position;   // position of key in keyList + 1
+    }
+
+    struct TxOperation {
+        bytes32 key;
+        bytes32 value;
+        bool deleteEntry;
+    }
+
+    mapping(bytes32 => Entry) private entries;      // meta data of stored keys
+    mapping(bytes32 => bytes32) private data;       // data store
+    bytes32[] internal keyList;                     // list of keys of data
+    mapping(bytes16 => TxOperation[]) private txBuffer; // buffer for transactions: maps transaction id to list of operations
+
+    /// Store the pair key:value in the storage.
+    /// @param key the new key to store
+    /// @param value the value corresponding to the key
+    function put(
+        bytes32 key,
+        bytes32 value)
+    external
+    {
+        _put(key, value);
+    }
+
+    function put(
+        bytes32 key,
+        bytes32 value,
+        bytes16 txId)
+    external
+    {
+        txBuffer[txId].push(TxOperation(key, value, false));
+    }
+
+    function clean(
+        bytes16 txId)
+    public
+    {
+        delete txBuffer[txId];
+    }
+
+    function commit(
+        bytes16 txId)
+    external
+    {
+        TxOperation[] storage values = txBuffer[txId];
+        uint length = values.length;
+
+        for (uint i = 0; i < length; ) {
+            TxOperation storage op = values[i];
+            if(op.deleteEntry) {
+                _remove(op.key);
+            } else {
+                _put(op.key, op.value);
+            }
+            unchecked { ++i; }
+        }
+
+        clean(txId);
+    }
+
+    /// Stores multiple key:value pairs in the storage.
+    /// @param keys An array of keys to store
+    /// @param values An array of values corresponding to the keys,
+    ///  thereby keys[i] should correspond to values[i]
+    function putBatch(
+        bytes32[] calldata keys,
+        bytes32[] calldata values)
+    external
+    {
+        uint length = keys.length;
+        for (uint i = 0; i < length; ) {
+            _put(keys[i], values[i]);
+            unchecked { ++i; }
+        }
+    }
+
+    function putBatch(
+        bytes32[] calldata keys,
+        bytes32[] calldata values,
+        bytes16 txId)
+    external
+    {
+        TxOperation[] storage buffer = txBuffer[txId];
+        uint length = keys.length;
+        for (uint i = 0; i < length; ) {
+            buffer.push(TxOperation(keys[i], values[i], false));
+            unchecked { ++i; }
+        }
+    }
+
+    /// Stores multiple key:value pairs, passed in packed encoding to save calldata.
+    /// @param packed For each pair: key length (1 byte), key, value length (1 byte), value;
+    ///  keys and values are padded with zeros to 32 bytes
+    function putBatchPacked(
+        bytes calldata packed)
+    external
+    {
+        uint pos = 0;
+        bytes32 key;
+        bytes32 value;
+
+        while (pos < packed.length) {
+            (key, pos) = _readPacked(packed, pos);
+            (value, pos) = _readPacked(packed, pos);
+            _put(key, value);
+        }
+    }
+
+    function putBatchPacked(
+        bytes calldata packed,
+        bytes16 txId)
+    external
+    {
+        TxOperation[] storage buffer = txBuffer[txId];
+        uint pos = 0;
+        bytes32 key;
+        bytes32 value;
+
+        while (pos < packed.length) {
+            (key, pos) = _readPacked(packed, pos);
+            (value, pos) = _readPacked(packed, pos);
+            buffer.push(TxOperation(key, value, false));
+        }
+    }
+
+    function remove(
+        bytes32 key)
+    external
+    {
+        _remove(key);
+    }
+
+    function remove(
+        bytes32 key,
+        bytes16 txId)
+    external
+    {
+        txBuffer[txId].push(TxOperation(key, 0, true));
+    }
+
+    /// Removes multiple key:value pairs in the storage.
+    /// @param keys An array of keys to remove
+    function removeBatch(
+        bytes32[] calldata keys)
+    external
+    {
+        uint length = keys.length;
+        for (uint i = 0; i < length; ) {
+            _remove(keys[i]);
+            unchecked { ++i; }
+        }
+    }
+
+    function removeBatch(
+        bytes32[] calldata keys,
+        bytes16 txId)
+    external
+    {
+        TxOperation[] storage buffer = txBuffer[txId];
+        uint length = keys.length;
+        for (uint i = 0; i < length; ) {
+            buffer.push(TxOperation(keys[i], 0, true));
+            unchecked { ++i; }
+        }
+    }
+
+    /// Applies puts and removes in their order, all in one (atomic) transaction.
+    /// @param keys An array of keys of all operations
+    /// @param values An array of values, values[i] is ignored if operation i is a remove
+    /// @param deleteBitmap Bit i is set if operation i is a remove (max. 256 operations)
+    function applyBatch(
+        bytes32[] calldata keys,
+        bytes32[] calldata values,
+        uint256 deleteBitmap)
+    external
+    {
+        uint length = keys.length;
+        require(length <= 256 && length == values.length);
+
+        for (uint i = 0; i < length; ) {
+            if((deleteBitmap >> i) & 1 == 1) {
+                _remove(keys[i]);
+            } else {
+                _put(keys[i], values[i]);
+            }
+            unchecked { ++i; }
+        }
+    }
+
+    /// Buffers puts and removes of a transaction, keeping their order.
+    /// @param keys An array of keys of all operations
+    /// @param values An array of values, values[i] is ignored if operation i is a remove
+    /// @param deleteBitmap Bit i is set if operation i is a remove (max. 256 operations)
+    function applyBatch(
+        bytes32[] calldata keys,
+        bytes32[] calldata values,
+        uint256 deleteBitmap,
+        bytes16 txId)
+    external
+    {
+        uint length = keys.length;
+        require(length <= 256 && length == values.length);
+
+        TxOperation[] storage buffer = txBuffer[txId];
+        for (uint i = 0; i < length; ) {
+            buffer.push(TxOperation(keys[i], values[i], (deleteBitmap >> i) & 1 == 1));
+            unchecked { ++i; }
+        }
+    }
+
+    function tableScan()
+    external
+    view
+    returns (bytes32[] memory keys, bytes32[] memory values)
+    {
+        uint size = keyList.length;
+        keys = new bytes32[](size);
+        values = new bytes32[](size);
+
+        for(uint i = 0; i < size; ) {
+            bytes32 key = keyList[i];
+            keys[i] = key;
+            values[i] = data[key];
+            unchecked { ++i; }
+        }
+
+        return (keys, values);
+    }
+
+    function get(
+        bytes32 key)
+    external
+    view
+    returns (bytes32 value, uint blocknumber)
+    {
+        blocknumber = entries[key].blocknumber;
+
+        // check if KV exists
+        require(blocknumber > 0);
+
+        return (data[key], blocknumber);
+    }
+
+    function getBatch(
+        bytes32[] calldata keys)
+    external
+    view
+    returns (bytes32[] memory values, uint[] memory blocknumbers)
+    {
+        uint length = keys.length;
+        values = new bytes32[](length);
+        blocknumbers = new uint[](length);
+        for (uint i = 0; i < length; ) {
+            values[i] = data[keys[i]];
+            blocknumbers[i] = entries[keys[i]].blocknumber;
+            unchecked { ++i; }
+        }
+        return (values, blocknumbers);
+    }
+
+    function drop()
+    external
+    {
+        selfdestruct(payable(msg.sender));
+    }
+
+    /// Reads one length prefixed element of packed at pos, returns it and the position of the next one
+    function _readPacked(
+        bytes calldata packed,
+        uint pos)
+    private
+    pure
+    returns (bytes32 element, uint next)
+    {
+        uint length;
+        assembly {
+            let p := add(packed.offset, pos)
+            length := byte(0, calldataload(p))
+            // keep first length bytes only
+            element := and(calldataload(add(p, 1)), not(shr(mul(8, length), not(0))))
+        }
+
+        unchecked { next = pos + 1 + length; }
+        require(length <= 32 && next <= packed.length);
+    }
+
+    /// Writes entry and value slot once; keyList only changes for new keys
+    function _put(
+        bytes32 key,
+        bytes32 value)
+    private
+    {
+        Entry memory e = entries[key];
+
+        if(e.blocknumber == 0) {
+            keyList.push(key);
+            e.position = uint192(keyList.length);
+        }
+
+        e.blocknumber = uint64(block.number);
+        entries[key] = e;
+        data[key] = value;
+    }
+
+    /// Swaps key with last element of keyList, then pops it
+    function _remove(
+        bytes32 key)
+    private
+    {
+        Entry memory e = entries[key];
+
+        if(e.blocknumber == 0) {
+            // key not found
+            return;
+        }
+
+        uint last = keyList.length;
+        if(e.position != last) {
+            bytes32 lastKey = keyList[last - 1];
+            keyList[e.position - 1] = lastKey; // move last element to position of key to delete
+            entries[lastKey].position = e.position;
+        }
+        keyList.pop();
+
+        delete entries[key];
+        delete data[key];
+    }
+
+}
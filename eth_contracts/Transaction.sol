@@ -14,8 +14,26 @@ contract Transaction  {
 
     }
 
+    /// Applies operations of all stores in one atomic transaction, without buffering them first.
+    /// @param stores Addresses of all stores
+    /// @param opsPerStore For each store: abi.encode(keys, values, deleteBitmap), see KVStore.applyBatch
+    function applyAll(
+        address[] memory stores,
+        bytes[] memory opsPerStore)
+    public
+    {
+        require(stores.length == opsPerStore.length);
+
+        for (uint i = 0; i < stores.length; i++) {
+            (bytes32[] memory keys, bytes32[] memory values, uint256 deleteBitmap) =
+                abi.decode(opsPerStore[i], (bytes32[], bytes32[], uint256));
+            KVStore(stores[i]).applyBatch(keys, values, deleteBitmap);
+        }
+    }
+
 }
 
 interface KVStore {
     function commit(bytes16 txId) external;
+    function applyBatch(bytes32[] calldata keys, bytes32[] calldata values, uint256 deleteBitmap) external;
 }
\ No newline at end of file
@@ -0,0 +1,78 @@
+// Compiles the store and commit contracts (eth_contracts/*.sol) into contract_abi/<contractName>.json
+// usage (in eth_tools): node src/compileContracts.js [contractName ...]
+const solc = require('solc');
+const fs = require('fs');
+const path = require('path');
+
+const CONTRACTS_DIR = path.join(__dirname, "../../eth_contracts");
+const OUTPUT_DIR = path.join(__dirname, "../contract_abi");
+
+// Compiler release per pragma of the contract sources
+const COMPILER_VERSIONS = {
+    "^0.6.8": "v0.6.8+commit.0bbfe453",
+    "^0.8.0": "v0.8.19+commit.7dd6d404"
+};
+
+function loadCompiler(version) {
+    return new Promise((resolve, reject) => {
+        solc.loadRemoteVersion(version, (err, compiler) => err ? reject(err) : resolve(compiler));
+    });
+}
+
+async function compileFile(file, wanted) {
+    const source = fs.readFileSync(path.join(CONTRACTS_DIR, file), "utf-8");
+    const pragma = source.match(/pragma solidity ([^;]+);/)[1].trim();
+    const version = COMPILER_VERSIONS[pragma];
+    if(!version) {
+        throw new Error("No compiler configured for pragma " + pragma + " of " + file);
+    }
+
+    const input = {
+        language: "Solidity",
+        sources: {[file]: {content: source}},
+        settings: {
+            optimizer: {enabled: true, runs: 200},
+            outputSelection: {"*": {"*": ["abi", "evm.bytecode.object", "evm.deployedBytecode.object"]}}
+        }
+    };
+
+    const compiler = await loadCompiler(version);
+    const output = JSON.parse(compiler.compile(JSON.stringify(input)));
+    const errors = (output.errors || []).filter((e) => e.severity === "error");
+    if(errors.length > 0) {
+        throw new Error(errors.map((e) => e.formattedMessage).join("\n"));
+    }
+
+    for(const [contractName, contract] of Object.entries(output.contracts[file])) {
+        if(wanted.length > 0 && !wanted.includes(contractName)) {
+            continue;
+        }
+
+        const artifact = {
+            contractName: contractName,
+            abi: contract.abi,
+            bytecode: "0x" + contract.evm.bytecode.object,
+            deployedBytecode: "0x" + contract.evm.deployedBytecode.object,
+            sourcePath: "eth_contracts/" + file,
+            compiler: {name: "solc", version: version}
+        };
+        fs.writeFileSync(path.join(OUTPUT_DIR, contractName + ".json"), JSON.stringify(artifact, null, 2) + "\n");
+        console.log("Compiled " + contractName + " (" + file + ", solc " + version + ")");
+    }
+}
+
+async function compileContracts(wanted = []) {
+    fs.mkdirSync(OUTPUT_DIR, {recursive: true});
+    for(const file of fs.readdirSync(CONTRACTS_DIR).filter((f) => f.endsWith(".sol"))) {
+        await compileFile(file, wanted);
+    }
+}
+
+module.exports = {compileContracts, OUTPUT_DIR};
+
+if(require.main === module) {
+    compileContracts(process.argv.slice(2)).catch((err) => {
+        console.error(err.message);
+        process.exit(1);
+    });
+}
@@ -1,21 +1,38 @@
+// Deploys a contract of eth_contracts, compiled from source before (see compileContracts.js)
+// usage (in eth_tools): node src/deployContract.js [KVStore|KVStoreV2|KVStoreMulti|KVLog|KVRollup|Transaction]
 const Web3 = require('web3');
 const fs = require('fs');
+const path = require('path');
+const {compileContracts, OUTPUT_DIR} = require('./compileContracts');
 
 const FROM_ACCOUNT="0xab81353220deccf2e8f931533ebaebd9348dd615";
-const COMPILED_CONTRACT = "contract_abi/KVStore.json";
+const CONTRACT_NAME = process.argv[2] || "KVStore";
 
 
 // Connect to Ethereum node
 const web3 = new Web3('http://localhost:8000');
 
-const contractFile = JSON.parse(fs.readFileSync(COMPILED_CONTRACT, "utf-8"));
-const contract = new web3.eth.Contract(contractFile.abi);
+async function deploy() {
+    await compileContracts([CONTRACT_NAME]);
 
-contract.deploy({data: contractFile.bytecode}).send({from: FROM_ACCOUNT}).then((newContract) => {
+    const compiledContract = path.join(OUTPUT_DIR, CONTRACT_NAME + ".json");
+    if(!fs.existsSync(compiledContract)) {
+        throw new Error("Unknown contract " + CONTRACT_NAME);
+    }
+
+    const contractFile = JSON.parse(fs.readFileSync(compiledContract, "utf-8"));
+    const contract = new web3.eth.Contract(contractFile.abi);
+
+    const newContract = await contract.deploy({data: contractFile.bytecode}).send({from: FROM_ACCOUNT});
     const address = newContract.options.address;
     if(address) {
-        console.log("Deployed successfully: " + address);
+        console.log("Deployed " + CONTRACT_NAME + " successfully: " + address);
     } else {
         console.error("Deployment failed!");
     }
+}
+
+deploy().catch((err) => {
+    console.error("Deployment failed: " + err.message);
+    process.exit(1);
 });
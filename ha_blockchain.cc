@@ -95,6 +95,7 @@
 #include "storage/blockchain/ha_blockchain.h"
 #include <sql/sql_thd_internal_api.h>
 #include <sql/table.h>
+#include <cerrno>
 #include <iostream>
 #include <vector>
 
@@ -102,6 +103,7 @@
 #include "mysql/components/services/log_builtins.h"
 #include "mysql/plugin.h"
 #include "sql/field.h"
+#include "sql/mysqld.h" /* mysql_tmpdir */
 #include "sql/sql_class.h"
 #include "sql/sql_plugin.h"
 #include "typelib.h"
@@ -118,10 +120,33 @@ static int config_type;
 static char* config_connection;
 static int config_use_ts_cache;
 static int config_tx_prepare_immediately;
+static int config_tx_prepare_workers;
+static int config_tx_flush_rows;
+static int config_tx_memory_budget;
+static int config_bulk_insert_batch_size;
 static char* config_eth_contracts;
 static char* config_eth_tx_contract;
 static char* config_eth_from;
 static int config_eth_max_waiting_time;
+static int config_eth_fee_policy;
+static int config_eth_fee_bump_percent;
+static int config_eth_replace_after;
+static int config_eth_access_lists;
+static int config_eth_rollup_interval;
+
+static Fee_config eth_fee_config() {
+  return Fee_config{config_eth_fee_policy, config_eth_fee_bump_percent, config_eth_replace_after};
+}
+
+/*
+ * Transaction state can not grow (memory or spill file exhausted): the operation is lost and
+ * single statements can not be rolled back, so the whole transaction is rolled back
+ */
+static int tx_out_of_memory(THD *thd) {
+  std::cerr << "[BLOCKCHAIN] Transaction state can not grow, transaction is rolled back" << std::endl;
+  thd->transaction_rollback_request = true;
+  return HA_ERR_OUT_OF_MEM;
+}
 
 /* Interface to mysqld, to check system tables supported by SE */
 static bool blockchain_is_supported_system_table(const char *db,
@@ -143,28 +168,45 @@ static int blockchain_init_func(void *p) {
   // Comment: blockchain_hton->prepare is not set 
   // --> Two-Phase Commit is not supported by this storage engine
 
+  Worker_pool::set_worker_count(config_tx_prepare_workers);
+  Spill_file::set_directory(mysql_tmpdir);
+
   // Parse configuration
   if(config_type == ETHEREUM) {
     ha_blockchain::table_contract_info =
         ha_blockchain::parse_eth_contract_config(config_eth_contracts);
+    Ethereum::use_access_lists = config_eth_access_lists == 1;
+    Ethereum_rollup::batch_interval = config_eth_rollup_interval;
+    ha_blockchain::recover_commits();
   }
 
   return 0;
 }
 
+static int blockchain_deinit_func(void *) {
+  DBUG_TRACE;
+
+  // Threads must not outlive the plugin library
+  Ethereum_rollup::stop_publishers();
+  return 0;
+}
+
 static handler *blockchain_create_handler(handlerton *hton, TABLE_SHARE *table,
                                        bool, MEM_ROOT *mem_root) {
   return new (mem_root) ha_blockchain(hton, table);
 }
 
 // Create static members
-std::unordered_map<Table_name, std::string>* ha_blockchain::table_contract_info;
+std::unordered_map<Table_name, Table_contract>* ha_blockchain::table_contract_info;
 std::mutex ha_blockchain::ha_data_create_tx_mtx;
 std::atomic_uint64_t Ethereum::nonce;
 std::mutex Ethereum::nonce_init_mtx;
+Gas_model Ethereum::gas_model;
+bool Ethereum::use_access_lists;
+int Ethereum_rollup::batch_interval;
 
 ha_blockchain::ha_blockchain(handlerton *hton, TABLE_SHARE *table_arg)
-    : handler(hton, table_arg) {
+    : handler(hton, table_arg), bulk_insert_active(false) {
   // ensure connection-scoped data structures are initialized
   init_HAData(ha_thd());
 }
@@ -235,6 +277,11 @@ int ha_blockchain::open(const char *full_table_name, int, uint, const dd::Table
 
   const char* table_name = table ? table->alias : full_table_name;
   find_connector(table_name);
+
+  // position() stores the key of the row in ref
+  if(table) {
+    ref_length = (*(table->field))->field_length;
+  }
   
   return 0;
 }
@@ -296,18 +343,31 @@ int ha_blockchain::write_row(uchar *buf) {
   extract_key(buf, &key);
   extract_value(buf, key.data_size, &value);
 
-  if(in_transaction()) {
-    // copy data in heap and store pointer in blockchain_tx object
+  if(in_transaction() || bulk_insert_active) {
+    // copy data in arena of blockchain_tx object / in heap for bulk insert buffer
+    Table_name table_name(table->alias);
+    bc_ha_data_table_t* bc_thd_data = bulk_insert_active ? nullptr : ha_data_get(ha_thd(), table_name);
+    Tx_arena* arena = bulk_insert_active ? nullptr : bc_thd_data->tx->get_arena();
 
     Put_op put_op;
-    put_op.value = Managed_byte_data(value.data_size);
+    put_op.value = Managed_byte_data(value.data_size, arena);
     memcpy(put_op.value.data->data(), value.data, value.data_size);
-    put_op.key = Managed_byte_data(key.data_size);
+    put_op.key = Managed_byte_data(key.data_size, arena);
     memcpy(put_op.key.data->data(), key.data, key.data_size);
 
-    Table_name table_name(table->alias);
-    auto bc_thd_data = ha_data_get(ha_thd(), table_name);
-    bc_thd_data->tx->add_put(std::move(put_op), connector.get());
+    if(bulk_insert_active) {
+      bulk_insert_buffer.emplace_back(std::move(put_op));
+
+      if(bulk_insert_buffer.size() >= (size_t) config_bulk_insert_batch_size) {
+        return flush_bulk_insert_buffer();
+      }
+
+      return 0;
+    }
+
+    if(bc_thd_data->tx->add_put(std::move(put_op), connector.get()) != 0) {
+      return tx_out_of_memory(ha_thd());
+    }
 
     return 0;
   } else {
@@ -384,22 +444,29 @@ int ha_blockchain::delete_row(const uchar *buf) {
   extract_key(const_cast<uchar *>(buf), &key);
 
   if(in_transaction()) {
-    // copy data in heap and store pointer in blockchain_tx object
+    // copy data in arena of blockchain_tx object
+    Table_name table_name(table->alias);
+    auto bc_thd_data = ha_data_get(ha_thd(), table_name);
 
     Remove_op remove_op;
 
-    remove_op.key = Managed_byte_data(key.data_size);
+    remove_op.key = Managed_byte_data(key.data_size, bc_thd_data->tx->get_arena());
     memcpy(remove_op.key.data->data(), key.data, key.data_size);
 
-    Table_name table_name(table->alias);
-    auto bc_thd_data = ha_data_get(ha_thd(), table_name);
-
     // Only add pending remove
     // --> allows to further iterate over cache without invalidating iterator pointers
-    bc_thd_data->tx->add_remove(std::move(remove_op), true, connector.get());
+    if(bc_thd_data->tx->add_remove(std::move(remove_op), true, connector.get()) != 0) {
+      return tx_out_of_memory(ha_thd());
+    }
 
     return 0;
   } else {
+    // Buffered rows of a running bulk insert must reach the blockchain before this remove
+    int rc = flush_bulk_insert_buffer();
+    if(rc != 0) {
+      return rc;
+    }
+
     // else (auto-commit): don't copy any data, just use buf to directly store data
     return connector->remove(&key);
   }
@@ -505,44 +572,51 @@ int ha_blockchain::index_read(uchar *buf, const uchar *key, uint,
     Table_name table_name(table->alias);
     auto& tx = ha_data_get(ha_thd(), table_name)->tx;
 
-    // Create temp key
-    Managed_byte_data tmp_key(key_BD.data_size);
-    memcpy(tmp_key.data->data(), key_BD.data, key_BD.data_size);
-
     /*Execute a GET if
       1. Table Scan Cache is not used
       2. Table Scan Cache is used but key does not exist
-
-      + re-apply pending TX operations 
+      and the key was not changed by the transaction (own changes overlay the blockchain rows)
     */
 
     if(!use_table_scan_cache() || 
-        tx->table_scan_data.find(tmp_key) == tx->table_scan_data.end()) {
-          
-      // Get single value
-      Managed_byte_data tmp_tuple(key_size + value_size);
-      auto get_rc = connector->get(&key_BD, tmp_tuple.data->data(), value_size);
-      tmp_tuple.data->erase(tmp_tuple.data->begin(), tmp_tuple.data->begin() + key_size); // only keep value part
-      if(get_rc == 0) {
-        // Put value into cache
-        tx->table_scan_data[tmp_key] = std::move(tmp_tuple);
-
-        // Apply pending ops
-        tx->reapply_pending_operations();
+        tx->table_scan_data.find(key_BD.data, key_BD.data_size) == nullptr) {
+
+      bool own_remove;
+      Byte_data own_value{};
+
+      if(tx->find_operation(key_BD.data, key_BD.data_size, own_remove, own_value)) {
+        if(own_remove) {
+          return 0;
+        }
+        tx->table_scan_data.put(key_BD.data, key_BD.data_size, own_value.data, own_value.data_size);
+        if(tx->table_scan_data.out_of_memory()) {
+          return tx_out_of_memory(ha_thd());
+        }
       } else {
-        return 0;
+        // Get single value
+        Managed_byte_data tmp_tuple(key_size + value_size);
+        auto get_rc = connector->get(&key_BD, tmp_tuple.data->data(), value_size);
+        if(get_rc == 0) {
+          // Put value into cache (only value part)
+          tx->table_scan_data.put(key_BD.data, key_BD.data_size, tmp_tuple.data->data() + key_size, value_size);
+          if(tx->table_scan_data.out_of_memory()) {
+            return tx_out_of_memory(ha_thd());
+          }
+        } else {
+          return 0;
+        }
       }
     }
 
     // Search, extract and copy value
-    auto iter = tx->table_scan_data.find(tmp_key);
-    if(iter != tx->table_scan_data.end()) { // Copy only if value was found
+    auto entry = tx->table_scan_data.find(key_BD.data, key_BD.data_size);
+    if(entry != nullptr) { // Copy only if value was found
       // Copy key
       memcpy(&(buf[pos]), key_BD.data, key_BD.data_size);
       pos += key_BD.data_size;
 
       // Copy value
-      memcpy(&buf[pos], iter->second.data->data(), iter->second.data->size());
+      memcpy(&buf[pos], entry->value, entry->value_size);
     }
 
     if(!use_table_scan_cache()) {
@@ -575,6 +649,7 @@ int ha_blockchain::rnd_init(bool) {
   size_t value_length = table->s->reclength - key_length - table->s->null_bytes;
 
   current_position = -1;
+  rnd_key_index.clear();
 
   if(in_transaction()) {
     Table_name table_name(table->alias);
@@ -588,12 +663,19 @@ int ha_blockchain::rnd_init(bool) {
 
     if(!tx->table_scan_data_filled) {
       connector->table_scan_to_map(tx->table_scan_data, key_length, value_length);
-      tx->reapply_pending_operations();
+      if(tx->table_scan_data.out_of_memory() || tx->reapply_pending_operations() != 0) {
+        tx->table_scan_data.clear(); // incomplete
+        return tx_out_of_memory(ha_thd());
+      }
       tx->table_scan_data_filled = true;
+      tx->check_memory_budget(connector.get());
     }
+    scan_end = tx->table_scan_data.size();
 
   } else {
+    rnd_table_scan_data.clear();
     connector->table_scan_to_vec(rnd_table_scan_data, key_length, value_length);
+    scan_end = rnd_table_scan_data.size();
   }
 
   DBUG_TRACE;
@@ -606,11 +688,15 @@ int ha_blockchain::rnd_end() {
   if(!in_transaction()) {
     // just clear temporary data used for table scan
     rnd_table_scan_data.clear();
+    rnd_key_index.clear();
   } else {
     Table_name table_name(table->alias);
     auto& tx = ha_data_get(ha_thd(), table_name)->tx;
-    tx->apply_pending_remove_ops(connector.get());
+    int rc = tx->apply_pending_remove_ops(connector.get());
     tx->pending_remove_activated = false;
+    if(rc != 0) {
+      return tx_out_of_memory(ha_thd());
+    }
 
     if(!use_table_scan_cache()) {
       tx->table_scan_data.clear();
@@ -638,42 +724,40 @@ int ha_blockchain::rnd_end() {
 int ha_blockchain::rnd_next(uchar *buf) {
   DBUG_TRACE;
 
-  current_position++; // necessary to do before fetching row so that position() still works
+  current_position++;
+  if(current_position >= scan_end) {
+    return HA_ERR_END_OF_FILE;
+  }
   return find_current_row(buf);
 }
 
 /**
   @brief
   position() is called after each call to rnd_next() if the data needs
-  to be ordered. You can do something like the following to store
-  the position:
-  @code
-  my_store_ptr(ref, ref_length, current_position);
-  @endcode
+  to be ordered. We store the key of the row (ref_length is the key length),
+  since positions in the scan data change when rows are removed.
 
   @details
-  The server uses ref to store data. ref_length in the above case is
-  the size needed to store current_position. ref is just a byte array
-  that the server will maintain. If you are using offsets to mark rows, then
-  current_position should be the offset. If it is a primary key like in
-  BDB, then it needs to be a primary key.
+  The server uses ref to store data. ref is just a byte array
+  that the server will maintain.
 
   Called from filesort.cc, sql_select.cc, sql_delete.cc, and sql_update.cc.
 
   @see
   filesort.cc, sql_select.cc, sql_delete.cc and sql_update.cc
 */
-void ha_blockchain::position(const uchar *) {
+void ha_blockchain::position(const uchar *record) {
   DBUG_TRACE;
-  my_store_ptr(ref, ref_length, current_position);
+  Byte_data key{};
+  extract_key(const_cast<uchar *>(record), &key);
+  memcpy(ref, key.data, std::min((uint) key.data_size, ref_length));
 }
 
 /**
   @brief
   This is like rnd_next, but you are given a position to use
-  to determine the row. The position will be of the type that you stored in
-  ref. You can use ha_get_ptr(pos,ref_length) to retrieve whatever key
-  or position you saved when position() was called.
+  to determine the row. The position is the key stored in ref by position(),
+  the row is looked up by this key (hash lookup).
 
   @details
   Called from filesort.cc, records.cc, sql_insert.cc, sql_select.cc, and
@@ -685,8 +769,7 @@ void ha_blockchain::position(const uchar *) {
 int ha_blockchain::rnd_pos(uchar *buf, uchar *pos) {
   DBUG_TRACE;
 
-  auto position = my_get_ptr(pos, ref_length);
-  return find_row(position, buf);
+  return find_row_by_key(pos, buf);
 }
 
 /**
@@ -791,6 +874,7 @@ int ha_blockchain::delete_all_rows() {
 */
 int ha_blockchain::external_lock(THD *thd, int lock_type) {
   if(lock_type == F_UNLCK) {
+    end_statement(thd);
     return 0;
   }
 
@@ -936,9 +1020,71 @@ int ha_blockchain::create(const char *name, TABLE *, HA_CREATE_INFO *,
 
 
 int ha_blockchain::start_stmt(THD *thd, thr_lock_type) {
+  // Inside LOCK TABLES, external_lock is not called for each statement
+  end_statement(thd);
   return start_transaction(thd);
 }
 
+void ha_blockchain::end_statement(THD *thd) {
+  if(!in_transaction()) {
+    return;
+  }
+
+  Table_name table_name(table->alias);
+  auto& tx = ha_data_get(thd, table_name)->tx;
+  if(tx != nullptr) {
+    tx->end_statement(connector.get());
+  }
+}
+
+/**
+  @brief
+  start_bulk_insert() is called before inserting a (possibly unknown, rows = 0)
+  number of rows, e.g. for INSERT ... SELECT or LOAD DATA.
+
+  @details
+  In a transaction, rows are already collected in the blockchain_table_tx
+  object and sent in batches during commit. In auto-commit mode, each row
+  would otherwise be its own blockchain transaction, so rows are buffered here
+  and flushed using put_batch once config_bulk_insert_batch_size rows are
+  collected, and finally in end_bulk_insert().
+*/
+void ha_blockchain::start_bulk_insert(ha_rows rows) {
+  DBUG_TRACE;
+
+  if(in_transaction()) {
+    return;
+  }
+
+  bulk_insert_active = true;
+  bulk_insert_buffer.clear();
+
+  size_t batch_size = config_bulk_insert_batch_size;
+  bulk_insert_buffer.reserve(rows == 0 ? batch_size : std::min((size_t) rows, batch_size));
+}
+
+int ha_blockchain::end_bulk_insert() {
+  DBUG_TRACE;
+
+  int rc = flush_bulk_insert_buffer();
+  bulk_insert_active = false;
+  bulk_insert_buffer.clear();
+
+  return rc;
+}
+
+int ha_blockchain::flush_bulk_insert_buffer() {
+  if(bulk_insert_buffer.empty()) {
+    return 0;
+  }
+
+  log("Flushing bulk insert with " + std::to_string(bulk_insert_buffer.size()) + " put operations");
+  int rc = connector->put_batch(&bulk_insert_buffer);
+  bulk_insert_buffer.clear();
+
+  return rc;
+}
+
 int ha_blockchain::start_transaction(THD *thd) {
   // Check if transaction needs to be created
   if(!in_transaction()) {
@@ -952,7 +1098,11 @@ int ha_blockchain::start_transaction(THD *thd) {
     std::lock_guard<std::mutex> lock(ha_data_create_tx_mtx);
     bc_ha_data->tx = std::make_unique<blockchain_table_tx>(thd,
                                                            blockchain_hton->slot,
-                                                           config_tx_prepare_immediately);
+                                                           table_name,
+                                                           config_tx_prepare_immediately,
+                                                           &bc_ha_data->arena,
+                                                           Tx_flush_config{config_tx_flush_rows},
+                                                           (size_t) config_tx_memory_budget * 1024 * 1024);
     log("Creating transaction and registering for table " + table_name);
 
     // register transaction in MySQL core
@@ -973,11 +1123,11 @@ int ha_blockchain::bc_commit(handlerton *, THD *thd, bool commit_trx) {
   }
 
   auto affected_tables = std::vector<Table_name>();
+  auto affected_txs = std::vector<std::unique_ptr<blockchain_table_tx>>();
   TXID txID;
 
-  // For each table that took part in transaction, prepare commit
+  // Collect all tables that were changed by the transaction
   for(auto& table_data : *ha_data_get_all(thd)) {
-    auto connector = table_data.second->connector;
     auto tx = std::move(table_data.second->tx);
 
     if(tx == nullptr) {
@@ -992,64 +1142,182 @@ int ha_blockchain::bc_commit(handlerton *, THD *thd, bool commit_trx) {
     // Add table to list of affected tables
     affected_tables.emplace_back(table_data.first);
     txID = tx->get_ID();
+    affected_txs.emplace_back(std::move(tx));
+  }
 
-    bool success_prepare = true;
+  if(affected_tables.empty()) {
+    return 0; // nothing to commit
+  }
 
-    if(config_tx_prepare_immediately) {
-      // Only wait until preparation is done
-      success_prepare = tx->wait_for_commit_prepare_workers();
-    } else {
-      // Prepare commit using batch operations
-      if(!tx->get_put_operations()->empty()) {
-        std::cout << "[BLOCKCHAIN] Preparing commit with " << tx->get_put_operations()->size() << " put operations" << std::endl;
-        int rc_putBatch = connector->put_batch(tx->get_put_operations(), tx->get_ID());
-        success_prepare = std::min(success_prepare, rc_putBatch == 0);
-        tx->get_put_operations()->clear();
-      }
+  auto allHAData = ha_data_get_all(thd);
 
-      if(!tx->get_remove_operations()->empty()) {
-        std::cout << "[BLOCKCHAIN] Preparing commit with " << tx->get_remove_operations()->size() << " remove operations" << std::endl;
-        int rc_removeBatch = connector->remove_batch(tx->get_remove_operations(), tx->get_ID());
-        success_prepare = std::min(success_prepare, rc_removeBatch == 0);
-        tx->get_remove_operations()->clear();
-      }
+  // Operations flushed before commit are in the tx buffer of the store contracts already,
+  // spilled operations are streamed from the spill file to the tx buffer
+  bool flushed = false;
+  for(auto& tx : affected_txs) {
+    flushed = flushed || tx->has_flushed() || tx->has_spilled();
+  }
+
+  // Only one table changed: apply operations directly in one (atomic) blockchain
+  // transaction, without buffering them in the store contract first
+  if(!config_tx_prepare_immediately && !flushed && affected_tables.size() == 1) {
+    auto connector = (*allHAData)[affected_tables[0]]->connector;
+    auto operations = affected_txs[0]->get_operations();
+
+    // Otherwise (nothing sent), the operations are buffered and committed below
+    int rc = connector->apply_single_transaction(operations);
+    if(rc == 0) {
+      std::cout << "[BLOCKCHAIN] Committed " << operations->size() << " operations directly" << std::endl;
+      return 0;
+    } else if(rc != APPLY_NOT_SINGLE_TRANSACTION) {
+      // Notify MySQL core (see sql/handler.cc)
+      thd->transaction_rollback_request = true;
+      return HA_ERR_INTERNAL_ERROR;
     }
+  }
 
-    if(!success_prepare) {
-      std::cerr << "Prepare of commit failed, will undo preparation of all involved tables. "
-                << "Transaction is deleted, please create a new one! "
-                << std::endl;
-      auto allHAData = ha_data_get_all(thd);
-      for(auto& table : affected_tables) {
-        auto table_connector = (*allHAData)[table]->connector;
-        table_connector->clear_commit_prepare(tx->get_ID());
+  auto contracts = std::vector<Table_contract>(affected_tables.size());
+  for(size_t i=0; i<affected_tables.size(); i++) {
+    contracts[i] = (*ha_blockchain::table_contract_info)[affected_tables[i]];
+  }
+
+  if(config_type == ETHEREUM && !Ethereum::is_atomic_commit_supported(contracts)) {
+    std::cerr << "Tables of a multi-table store contract can only be changed in one transaction "
+              << "with tables of the same store contract, rollup tables only alone. "
+              << "Transaction is deleted!" << std::endl;
+    if(config_tx_prepare_immediately || flushed) {
+      int rc_clear = 0;
+      for(size_t i=0; i<affected_tables.size(); i++) {
+        affected_txs[i]->wait_for_commit_prepare_workers();
+        rc_clear = std::max(rc_clear, (*allHAData)[affected_tables[i]]->connector->clear_commit_prepare(txID));
+      }
+      if(rc_clear == 0) {
+        Commit_journal::get().done(txID); // otherwise cleaned by recovery
       }
+    }
 
+    // Notify MySQL core (see sql/handler.cc)
+    thd->transaction_rollback_request = true;
+    return HA_ERR_INTERNAL_ERROR;
+  }
+
+  // Several tables changed: if all operations fit into one blockchain transaction,
+  // pass them to the commit contract directly (no buffering in the store contracts)
+  if(!config_tx_prepare_immediately && !flushed && config_type == ETHEREUM) {
+    auto operations = std::vector<std::vector<Batch_op>*>(affected_txs.size());
+    for(size_t i=0; i<affected_txs.size(); i++) {
+      operations[i] = affected_txs[i]->get_operations();
+    }
+
+    // Otherwise (nothing sent), the operations are buffered and committed below
+    int rc = Ethereum::atomic_apply(std::string(config_connection),
+                                    std::string(config_eth_from),
+                                    config_eth_max_waiting_time,
+                                    eth_fee_config(),
+                                    std::string(config_eth_tx_contract),
+                                    contracts, operations);
+    if(rc == 0) {
+      std::cout << "[BLOCKCHAIN] Committed " << affected_tables.size() << " tables directly" << std::endl;
+      return 0;
+    } else if(rc != APPLY_NOT_SINGLE_TRANSACTION) {
       // Notify MySQL core (see sql/handler.cc)
       thd->transaction_rollback_request = true;
-
       return HA_ERR_INTERNAL_ERROR;
     }
   }
 
-  if(affected_tables.empty()) {
-    return 0; // nothing to commit
+  // For each table that took part in transaction, prepare commit
+  // --> preparation of all tables is sent first and awaited together afterwards
+  bool success_prepare = true;
+  for(size_t i=0; i<affected_tables.size(); i++) {
+    auto connector = (*allHAData)[affected_tables[i]]->connector;
+    auto& tx = affected_txs[i];
+
+    if(config_tx_prepare_immediately) {
+      // Send operations of the last statement, if not done yet
+      tx->end_statement(connector);
+    } else {
+      // Prepare commit using batch operations: puts and removes in one ordered batch
+      // (only operations that were not flushed before)
+      std::cout << "[BLOCKCHAIN] Preparing commit" << (tx->has_spilled() ? " (spilled to disk)" : "") << std::endl;
+      tx->flush(connector);
+    }
   }
 
-  // Preparation of commit was successful --> call commit contract with all
-  // addresses to do atomic commit
-  auto addresses = std::vector<std::string>(affected_tables.size());
-  for(size_t i=0; i<affected_tables.size(); i++) {
-    addresses[i] = (*ha_blockchain::table_contract_info)[affected_tables[i]];
+  // Wait until preparation is sent
+  for(auto& tx : affected_txs) {
+    success_prepare = std::min(success_prepare, tx->wait_for_commit_prepare_workers());
+  }
+
+  // Wait until preparation of all tables is mined
+  for(auto& table : affected_tables) {
+    int rc_wait = (*allHAData)[table]->connector->wait_for_submitted();
+    success_prepare = std::min(success_prepare, rc_wait == 0);
+  }
+
+  if(!success_prepare) {
+    std::cerr << "Prepare of commit failed, will undo preparation of all involved tables. "
+              << "Transaction is deleted, please create a new one! "
+              << std::endl;
+    int rc_clear = 0;
+    for(auto& table : affected_tables) {
+      auto table_connector = (*allHAData)[table]->connector;
+      rc_clear = std::max(rc_clear, table_connector->clear_commit_prepare(txID));
+    }
+    if(rc_clear == 0) {
+      Commit_journal::get().done(txID); // otherwise cleaned by recovery
+    }
+
+    // Notify MySQL core (see sql/handler.cc)
+    thd->transaction_rollback_request = true;
+
+    return HA_ERR_INTERNAL_ERROR;
+  }
+
+  // Record the commit before it is sent: after a crash, recovery sends commitAll again
+  if(Commit_journal::get().commit(txID, affected_tables) != 0) {
+    std::cerr << "Commit journal not writable, transaction is deleted!" << std::endl;
+    for(auto& table : affected_tables) {
+      (*allHAData)[table]->connector->clear_commit_prepare(txID);
+    }
+
+    // Notify MySQL core (see sql/handler.cc)
+    thd->transaction_rollback_request = true;
+    return HA_ERR_INTERNAL_ERROR;
   }
 
+  // Preparation of commit was successful --> call commit contract with all
+  // addresses (or multi-table store with all table ids) to do atomic commit
   switch (config_type) {
     case ETHEREUM: {
-      return Ethereum::atomic_commit(std::string(config_connection),
-                                    std::string(config_eth_from),
-                                    config_eth_max_waiting_time,
-                                    std::string(config_eth_tx_contract),
-                                    txID, addresses);
+      int rc = Ethereum::atomic_commit(std::string(config_connection),
+                                       std::string(config_eth_from),
+                                       config_eth_max_waiting_time,
+                                       eth_fee_config(),
+                                       std::string(config_eth_tx_contract),
+                                       txID, contracts);
+      if(rc == 0) {
+        Commit_journal::get().done(txID);
+        return 0;
+      }
+
+      if(rc != ATOMIC_COMMIT_UNKNOWN) {
+        // commitAll failed (reverted or not sent): nothing is committed, clean tx buffers
+        int rc_clear = 0;
+        for(auto& table : affected_tables) {
+          rc_clear = std::max(rc_clear, (*allHAData)[table]->connector->clear_commit_prepare(txID));
+        }
+        if(rc_clear == 0) {
+          Commit_journal::get().done(txID); // otherwise cleaned by recovery
+        } else {
+          Commit_journal::get().abort(txID); // recovery cleans instead of committing
+        }
+      }
+      // else: outcome unknown (not mined in time), recovery finishes the commit after a restart
+
+      // Notify MySQL core (see sql/handler.cc)
+      thd->transaction_rollback_request = true;
+      return HA_ERR_INTERNAL_ERROR;
     }
     default: return HA_ERR_WRONG_COMMAND;
   }
@@ -1062,6 +1330,8 @@ int ha_blockchain::bc_rollback(handlerton *, THD *thd, bool all) {
   }
 
   // For each table that took part in transaction, delete pending operations
+  TXID txID = boost::uuids::nil_uuid();
+  int rc_clear = 0;
   for(auto& table_data : *ha_data_get_all(thd)) {
     auto tx = std::move(table_data.second->tx);
 
@@ -1070,13 +1340,18 @@ int ha_blockchain::bc_rollback(handlerton *, THD *thd, bool all) {
       continue;
     }
 
-    if(config_tx_prepare_immediately) {
+    if(config_tx_prepare_immediately || tx->has_flushed()) {
       tx->wait_for_commit_prepare_workers(); // ensure threads shut down gracefully
       auto tableConnector = table_data.second->connector;
-      tableConnector->clear_commit_prepare(tx->get_ID());
+      rc_clear = std::max(rc_clear, tableConnector->clear_commit_prepare(tx->get_ID()));
+      txID = tx->get_ID();
     }
   }
 
+  if(!txID.is_nil() && rc_clear == 0) {
+    Commit_journal::get().done(txID); // otherwise cleaned by recovery
+  }
+
   return 0;
 }
 
@@ -1116,13 +1391,10 @@ int ha_blockchain::find_row(my_off_t index, uchar *buf) {
       return HA_ERR_END_OF_FILE;
     }
 
-    auto ts_pos = tx->table_scan_data.begin();
-    std::advance(ts_pos, index);
-    auto* key = &(ts_pos->first);
-    auto* value = &(ts_pos->second);
-    memcpy(&(buf[pos]), key->data->data(), key->data->size());
-    pos += key->data->size();
-    memcpy(&(buf[pos]), value->data->data(), value->data->size());
+    auto& entry = tx->table_scan_data.at(index); // entries are dense, no iteration needed
+    memcpy(&(buf[pos]), entry.key, entry.key_size);
+    pos += entry.key_size;
+    memcpy(&(buf[pos]), entry.value, entry.value_size);
     return 0;
   }
 
@@ -1137,15 +1409,99 @@ int ha_blockchain::find_row(my_off_t index, uchar *buf) {
   return 0;
 }
 
-std::unordered_map<Table_name, std::string>* ha_blockchain::parse_eth_contract_config(char *config) {
-  auto map = new std::unordered_map<Table_name, std::string>();
+int ha_blockchain::find_row_by_key(const uchar *key, uchar *buf) {
+
+  // set required zero bits
+  uint initial_null_bytes = table->s->null_bytes;
+  memset(buf, 0, initial_null_bytes);
+  uint pos = initial_null_bytes;
+
+  if(in_transaction()) {
+    Table_name table_name(table->alias);
+    auto& tx = ha_data_get(ha_thd(), table_name)->tx;
+    auto entry = tx->table_scan_data.find(key, ref_length);
+    if(entry == nullptr) {
+      return HA_ERR_RECORD_DELETED;
+    }
+
+    memcpy(&(buf[pos]), entry->key, entry->key_size);
+    pos += entry->key_size;
+    memcpy(&(buf[pos]), entry->value, entry->value_size);
+    return 0;
+  }
+
+  // Not in transaction --> index rnd cache by key on first use
+  if(rnd_key_index.empty()) {
+    rnd_key_index.reserve(rnd_table_scan_data.size());
+    for(my_off_t i = 0; i < rnd_table_scan_data.size(); i++) {
+      auto* tuple = rnd_table_scan_data[i].data->data();
+      rnd_key_index.emplace(std::string(reinterpret_cast<char*>(tuple), ref_length), i);
+    }
+  }
+
+  auto entry = rnd_key_index.find(std::string(reinterpret_cast<const char*>(key), ref_length));
+  if(entry == rnd_key_index.end()) {
+    return HA_ERR_RECORD_DELETED;
+  }
+
+  return find_row(entry->second, buf);
+}
+
+/*
+ * Decimal number <= max (not std::stoul, which throws during plugin init)
+ */
+static bool parse_config_number(const std::string& text, uint64_t max, uint64_t& value) {
+  const char* begin = text.c_str();
+  char* end;
+  errno = 0;
+  unsigned long long number = strtoull(begin, &end, 10);
+  if(*begin < '0' || *begin > '9' || *end != '\0' || errno != 0 || number > max) {
+    return false;
+  }
+
+  value = number;
+  return true;
+}
+
+/*
+ * Parses tableName:address[:layout],... where layout is v1 (default), v2, log[:block], rollup or
+ * multi:tableId
+ */
+std::unordered_map<Table_name, Table_contract>* ha_blockchain::parse_eth_contract_config(char *config) {
+  auto map = new std::unordered_map<Table_name, Table_contract>();
   std::string conf(config);
   std::stringstream ss(conf);
   std::string entry;
 
   while (std::getline(ss, entry, ',')) {
-    size_t i = entry.find(':');
-    map->insert({entry.substr(0, i).c_str(), entry.substr(i+1, std::string::npos)});
+    std::vector<std::string> parts;
+    boost::split(parts, entry, boost::is_any_of(":"));
+
+    Table_contract contract;
+    contract.address = parts.size() > 1 ? parts[1] : "";
+    if(parts.size() > 2 && boost::iequals(parts[2], "v2")) {
+      contract.layout = STORE_LAYOUT_V2;
+    } else if(parts.size() > 2 && boost::iequals(parts[2], "log")) {
+      contract.layout = STORE_LAYOUT_LOG;
+      if(parts.size() > 3 && !parse_config_number(parts[3], UINT64_MAX, contract.first_block)) {
+        std::cerr << "[BLOCKCHAIN] Invalid deployment block in contract config entry '" << entry
+                  << "', table is ignored" << std::endl;
+        continue;
+      }
+    } else if(parts.size() > 2 && boost::iequals(parts[2], "rollup")) {
+      contract.layout = STORE_LAYOUT_ROLLUP;
+    } else if(parts.size() > 2 && boost::iequals(parts[2], "multi")) {
+      uint64_t table_id;
+      if(parts.size() < 4 || !parse_config_number(parts[3], UINT32_MAX, table_id)) {
+        std::cerr << "[BLOCKCHAIN] Invalid table id in contract config entry '" << entry
+                  << "', table is ignored" << std::endl;
+        continue;
+      }
+      contract.layout = STORE_LAYOUT_MULTI;
+      contract.table_id = (uint32_t) table_id;
+    }
+
+    map->insert({parts[0], contract});
   }
 
   return map;
@@ -1179,30 +1535,104 @@ void ha_blockchain::find_connector(const char* full_table_name) {
   boost::split(nameParts, full_table_name, boost::is_any_of("/"));
   Table_name table_name = nameParts.back();
 
+  Table_contract contract;
+  auto searchAddress = ha_blockchain::table_contract_info->find(table_name);
+  if(searchAddress != ha_blockchain::table_contract_info->end()) {
+    contract = searchAddress->second;
+  }
+
+  connector = create_connector(contract);
+
+  // save in THD data
+  if(connector != nullptr) {
+    auto bc_ha_data = ha_data_get(ha_thd(), table_name);
+    bc_ha_data->connector = connector.get();
+    log("Stored connector in HA_DATA for " + table_name);
+  }
+}
+
+std::unique_ptr<Connector> ha_blockchain::create_connector(const Table_contract& contract) {
   switch(config_type) {
     case 0: {
-      auto searchAddress = ha_blockchain::table_contract_info->find(table_name);
-      std::string contract_address;
-      if(searchAddress != ha_blockchain::table_contract_info->end()) {
-        contract_address = searchAddress->second;
-      }
-
-      connector = std::make_unique<Ethereum>(std::string(config_connection),
-                                              contract_address,
+      if(contract.layout == STORE_LAYOUT_LOG) {
+        return std::make_unique<Ethereum_log>(std::string(config_connection),
+                                              contract.address,
                                               std::string(config_eth_from),
-                                              config_eth_max_waiting_time);
-
-      break;
+                                              config_eth_max_waiting_time,
+                                              eth_fee_config(),
+                                              contract.first_block);
+      } else if(contract.layout == STORE_LAYOUT_ROLLUP) {
+        return std::make_unique<Ethereum_rollup>(std::string(config_connection),
+                                                 contract.address,
+                                                 std::string(config_eth_from),
+                                                 config_eth_max_waiting_time,
+                                                 eth_fee_config());
+      } else {
+        return std::make_unique<Ethereum>(std::string(config_connection),
+                                          contract.address,
+                                          std::string(config_eth_from),
+                                          config_eth_max_waiting_time,
+                                          eth_fee_config(),
+                                          contract.layout,
+                                          contract.table_id);
+      }
     }
 
     default: std::cout << "Error! Unknown blockchain type" << std::endl;
   }
 
-  // save in THD data
-  if(connector != nullptr) {
-    auto bc_ha_data = ha_data_get(ha_thd(), table_name);
-    bc_ha_data->connector = connector.get();
-    log("Stored connector in HA_DATA for " + table_name);
+  return nullptr;
+}
+
+/*
+ * Finishes the commits that were in flight when the server stopped (see Commit_journal):
+ * commitAll is sent again if it was sent before (a no-op if it was mined already). If it was
+ * not sent or fails, the tx buffers are cleaned. Entries that can not be finished (e.g. node
+ * not reachable) stay in the journal for the next start.
+ */
+void ha_blockchain::recover_commits() {
+  for(auto& entry : Commit_journal::get().open(COMMIT_JOURNAL_FILE)) {
+    auto contracts = std::vector<Table_contract>();
+    for(auto& table : entry.tables) {
+      auto contract = table_contract_info->find(table);
+      if(contract == table_contract_info->end()) {
+        std::cerr << "[BLOCKCHAIN] Recovery: no store contract configured for table " << table << std::endl;
+        continue;
+      }
+      contracts.push_back(contract->second);
+    }
+
+    if(contracts.empty()) {
+      continue;
+    }
+
+    int rc = 1;
+    if(entry.committing) {
+      std::cout << "[BLOCKCHAIN] Recovery: finishing commit of " << contracts.size() << " tables" << std::endl;
+      rc = Ethereum::atomic_commit(std::string(config_connection),
+                                   std::string(config_eth_from),
+                                   config_eth_max_waiting_time,
+                                   eth_fee_config(),
+                                   std::string(config_eth_tx_contract),
+                                   entry.id, contracts);
+      if(rc == 1) {
+        Commit_journal::get().abort(entry.id);
+      }
+    }
+
+    if(rc == 1) {
+      // not committing, or commitAll failed: clean tx buffers
+      rc = 0;
+      std::cout << "[BLOCKCHAIN] Recovery: cleaning prepared commit of " << contracts.size() << " tables" << std::endl;
+      for(auto& contract : contracts) {
+        auto table_connector = create_connector(contract);
+        rc = std::max(rc, table_connector == nullptr ? 1 : table_connector->clear_commit_prepare(entry.id));
+      }
+    }
+
+    if(rc == 0) {
+      Commit_journal::get().done(entry.id);
+    }
   }
 }
 
@@ -1280,11 +1710,27 @@ static MYSQL_SYSVAR_INT(bc_use_ts_cache, config_use_ts_cache, 0,
                         nullptr, 1,0, 1, 0);
 
 static MYSQL_SYSVAR_INT(bc_tx_prepare_immediately, config_tx_prepare_immediately, 0,
-                        "Blockchain transactions: immediately send operations to BC buffer", nullptr,
+                        "Blockchain transactions: send operations to BC buffer at the end of each statement", nullptr,
                         nullptr, 0,0, 1, 0);
 
+static MYSQL_SYSVAR_INT(bc_tx_prepare_workers, config_tx_prepare_workers, PLUGIN_VAR_READONLY,
+                        "Blockchain transactions: number of engine-wide worker threads sending statement batches to BC buffer",
+                        nullptr, nullptr, 16, 1, 256, 0);
+
+static MYSQL_SYSVAR_INT(bc_tx_flush_rows, config_tx_flush_rows, 0,
+                        "Blockchain transactions: send buffered operations to BC buffer before commit once this many are buffered (0: off)",
+                        nullptr, nullptr, 0, 0, 1000000, 0);
+
+static MYSQL_SYSVAR_INT(bc_tx_memory_budget, config_tx_memory_budget, 0,
+                        "Blockchain transactions: memory per table of a transaction (in MB) before its state is spilled to disk (0: unlimited)",
+                        nullptr, nullptr, 0, 0, 1048576, 0);
+
+static MYSQL_SYSVAR_INT(bc_bulk_insert_batch_size, config_bulk_insert_batch_size, 0,
+                        "Blockchain bulk insert (auto-commit): max. number of rows sent in one put_batch", nullptr,
+                        nullptr, 1000, 1, 10000, 0);
+
 static MYSQL_SYSVAR_STR(bc_eth_contracts, config_eth_contracts, PLUGIN_VAR_RQCMDARG | PLUGIN_VAR_READONLY,
-                        "Ethereum store contract addresses", nullptr, nullptr,
+                        "Ethereum store contracts: tableName:address[:v2|:log[:block]|:rollup|:multi:tableId],...", nullptr, nullptr,
                         nullptr);
 
 static MYSQL_SYSVAR_STR(bc_eth_tx_contract, config_eth_tx_contract, PLUGIN_VAR_RQCMDARG | PLUGIN_VAR_READONLY,
@@ -1299,15 +1745,44 @@ static MYSQL_SYSVAR_INT(bc_eth_max_waiting_time, config_eth_max_waiting_time, 0,
                         "Ethereum max. time to wait for transaction mined (in seconds)", nullptr, nullptr, 32,
                         16, 300, 0);
 
+static MYSQL_SYSVAR_INT(bc_eth_fee_policy, config_eth_fee_policy, 0,
+                        "Ethereum transaction fees (0: node default, 1: eth_gasPrice, 2: EIP-1559 based on eth_feeHistory)",
+                        nullptr, nullptr, 1, 0, 2, 0);
+
+static MYSQL_SYSVAR_INT(bc_eth_fee_bump_percent, config_eth_fee_bump_percent, 0,
+                        "Ethereum fee increase (in percent) when replacing a pending transaction", nullptr, nullptr, 15,
+                        10, 100, 0);
+
+static MYSQL_SYSVAR_INT(bc_eth_replace_after, config_eth_replace_after, 0,
+                        "Ethereum time until a pending transaction is replaced with a higher fee (in seconds)", nullptr,
+                        nullptr, 12, 1, 300, 0);
+
+static MYSQL_SYSVAR_INT(bc_eth_access_lists, config_eth_access_lists, PLUGIN_VAR_READONLY,
+                        "Ethereum EIP-2930 access lists for transactions (0: off, 1: on, needs Berlin fork)", nullptr,
+                        nullptr, 0, 0, 1, 0);
+
+static MYSQL_SYSVAR_INT(bc_eth_rollup_interval, config_eth_rollup_interval, PLUGIN_VAR_READONLY,
+                        "Ethereum rollup tables: time between published batches (in seconds)", nullptr,
+                        nullptr, 60, 1, 86400, 0);
+
 static SYS_VAR *blockchain_system_variables[] = {
     MYSQL_SYSVAR(bc_type), // blockchain type: 0 - ethereum
     MYSQL_SYSVAR(bc_connection), // blockchain connection string (e.g. for Ethereum: http://127.0.0.1:8545)
     MYSQL_SYSVAR(bc_use_ts_cache), // 1 - yes, 0 - no
     MYSQL_SYSVAR(bc_tx_prepare_immediately), // 1 - yes, 0 - no
-    MYSQL_SYSVAR(bc_eth_contracts), // Concept: one contract per table, format: tableName1:contractAddress,tableName2:contractAddress,...
+    MYSQL_SYSVAR(bc_tx_prepare_workers), // used with bc_tx_prepare_immediately and for flushes
+    MYSQL_SYSVAR(bc_tx_flush_rows), // without bc_tx_prepare_immediately
+    MYSQL_SYSVAR(bc_tx_memory_budget), // operation log and transaction cache are moved into files in tmpdir
+    MYSQL_SYSVAR(bc_bulk_insert_batch_size), // rows per put_batch, connector splits it into transactions that fit into a block
+    MYSQL_SYSVAR(bc_eth_contracts), // Concept: one contract per table (or many tables per multi-table contract), format: tableName1:contractAddress[:v2|:log[:block]|:rollup|:multi:tableId],tableName2:contractAddress,...
     MYSQL_SYSVAR(bc_eth_tx_contract),
     MYSQL_SYSVAR(bc_eth_from),
     MYSQL_SYSVAR(bc_eth_max_waiting_time),
+    MYSQL_SYSVAR(bc_eth_fee_policy), // 0 - node default, 1 - legacy gas price, 2 - EIP-1559
+    MYSQL_SYSVAR(bc_eth_fee_bump_percent),
+    MYSQL_SYSVAR(bc_eth_replace_after),
+    MYSQL_SYSVAR(bc_eth_access_lists), // 1 - yes, 0 - no
+    MYSQL_SYSVAR(bc_eth_rollup_interval),
     nullptr
 };
 
@@ -1320,7 +1795,7 @@ mysql_declare_plugin(blockchain){
     PLUGIN_LICENSE_GPL,
     blockchain_init_func, /* Plugin Init */
     nullptr,           /* Plugin check uninstall */
-    nullptr,           /* Plugin Deinit */
+    blockchain_deinit_func, /* Plugin Deinit */
     0x0001 /* 0.1 */,
     0,              /* status variables */
     blockchain_system_variables, /* system variables */
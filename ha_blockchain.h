@@ -55,13 +55,17 @@
 */
 class ha_blockchain : public handler {
   my_off_t current_position; // current position during table scan
+  my_off_t scan_end; // number of rows when the table scan started (rows added during the scan are skipped)
   std::unique_ptr<Connector> connector;
   std::vector<Managed_byte_data> rnd_table_scan_data;
+  std::unordered_map<std::string, my_off_t> rnd_key_index; // key to position in rnd_table_scan_data, built by rnd_pos
+  std::vector<Put_op> bulk_insert_buffer; // rows buffered during bulk insert in auto-commit mode
+  bool bulk_insert_active;
   static std::mutex ha_data_create_tx_mtx;
 
  public:
-  // Maps table name to contract address
-  static std::unordered_map<Table_name, std::string>* table_contract_info;
+  // Maps table name to store contract (address and layout)
+  static std::unordered_map<Table_name, Table_contract>* table_contract_info;
 
   ha_blockchain(handlerton *hton, TABLE_SHARE *table_arg);
   ~ha_blockchain();
@@ -252,6 +256,15 @@ class ha_blockchain : public handler {
   @return 0 or error code */
   int start_stmt(THD *thd, thr_lock_type lock_type);
 
+  /** @brief
+    Called before a multi-row insert (INSERT ... SELECT, LOAD DATA, multi-row
+    VALUES). In auto-commit mode, rows are buffered and sent with put_batch
+    instead of one blockchain transaction per row.
+  */
+  void start_bulk_insert(ha_rows rows);
+  int end_bulk_insert();
+  int flush_bulk_insert_buffer();
+
   /** @brief
    * Logging helper
    */
@@ -262,11 +275,14 @@ class ha_blockchain : public handler {
 
   int find_current_row(uchar *buf);
   int find_row(my_off_t index, uchar *buf);
+  int find_row_by_key(const uchar *key, uchar *buf);
 
   void extract_key(uchar* buf, Byte_data* key);
   void extract_value(uchar* buf, ulong key_size, Byte_data* value);
 
-  static std::unordered_map<std::string, std::string>* parse_eth_contract_config(char* config);
+  static std::unordered_map<Table_name, Table_contract>* parse_eth_contract_config(char* config);
+  static std::unique_ptr<Connector> create_connector(const Table_contract& contract);
+  static void recover_commits();
   static inline void init_HAData(THD* thd);
   static bc_ha_data_table_t* ha_data_get(THD* thd, Table_name& table);
   static ha_data_map* ha_data_get_all(THD* thd);
@@ -277,6 +293,7 @@ class ha_blockchain : public handler {
 
   /** Commits a transaction or marks an SQL statement ended.*/
   int start_transaction(THD *thd);
+  void end_statement(THD *thd);
   static int bc_commit(handlerton *hton, THD *thd, bool commit_trx);
   static int bc_rollback(handlerton *hton, THD *thd, bool all);
 
@@ -0,0 +1,119 @@
+#include "journal_file.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+Journal_file::~Journal_file() {
+  if(fd >= 0) {
+    close(fd);
+  }
+}
+
+std::string Journal_file::encode_record(char type, const std::string& payload) {
+  std::string record(1, type);
+  uint32_t length = payload.size();
+  record.append(reinterpret_cast<const char*>(&length), 4);
+  record.append(payload);
+  return record;
+}
+
+/*
+ * Records are read one at a time, so only the largest record is held in memory
+ */
+int Journal_file::open(const std::string& path, const Replay& replay) {
+  this->path = path;
+
+  std::ifstream in(path, std::ios::binary | std::ios::ate);
+  uint64_t end = in ? (uint64_t) in.tellg() : 0;
+  in.seekg(0);
+
+  std::string payload;
+  uint64_t pos = 0;
+  char header[5];
+  while(pos + 5 <= end && in.read(header, 5)) {
+    uint32_t length;
+    memcpy(&length, header + 1, 4);
+    if(pos + 5 + length > end) {
+      break; // incomplete record of interrupted write
+    }
+    payload.resize(length);
+    if(!in.read(&payload[0], length)) {
+      break;
+    }
+    if(!replay(header[0], payload.data(), length, pos)) {
+      break;
+    }
+    pos += 5 + length;
+  }
+
+  fd = ::open(path.c_str(), O_WRONLY | O_CREAT, 0640);
+  if(fd < 0 || ftruncate(fd, pos) != 0 || lseek(fd, pos, SEEK_SET) < 0) {
+    std::cerr << "[BLOCKCHAIN] Can not open " << name << " " << path << ": " << strerror(errno) << std::endl;
+    if(fd >= 0) {
+      close(fd);
+      fd = -1;
+    }
+    return 1;
+  }
+
+  file_size = pos;
+  return 0;
+}
+
+int Journal_file::append(char type, const std::string& payload) {
+  if(fd < 0) {
+    return 1;
+  }
+
+  std::string record = encode_record(type, payload);
+  if(write(fd, record.data(), record.size()) != (ssize_t) record.size() || fdatasync(fd) != 0) {
+    std::cerr << "[BLOCKCHAIN] Write of " << name << " failed: " << strerror(errno) << std::endl;
+    // drop partial record, it would be skipped during replay anyway
+    if(ftruncate(fd, file_size) != 0 || lseek(fd, file_size, SEEK_SET) < 0) {
+      close(fd);
+      fd = -1;
+    }
+    return 1;
+  }
+
+  file_size += record.size();
+  return 0;
+}
+
+int Journal_file::truncate() {
+  if(fd < 0 || ftruncate(fd, 0) != 0 || lseek(fd, 0, SEEK_SET) != 0) {
+    return 1;
+  }
+
+  file_size = 0;
+  return 0;
+}
+
+int Journal_file::rewrite(const std::string& records) {
+  std::string tmp_path = path + ".tmp";
+  int tmp_fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0640);
+  if(tmp_fd < 0) {
+    std::cerr << "[BLOCKCHAIN] Can not open " << name << " " << tmp_path << ": " << strerror(errno) << std::endl;
+    return 1;
+  }
+
+  if(write(tmp_fd, records.data(), records.size()) != (ssize_t) records.size() || fdatasync(tmp_fd) != 0 ||
+     rename(tmp_path.c_str(), path.c_str()) != 0) {
+    std::cerr << "[BLOCKCHAIN] Rewrite of " << name << " failed: " << strerror(errno) << std::endl;
+    close(tmp_fd);
+    unlink(tmp_path.c_str());
+    return 1;
+  }
+
+  if(fd >= 0) {
+    close(fd);
+  }
+  fd = tmp_fd;
+  file_size = records.size();
+  return 0;
+}
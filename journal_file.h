@@ -0,0 +1,52 @@
+#ifndef MYSQL_BLOCKCHAIN_JOURNAL_FILE_H
+#define MYSQL_BLOCKCHAIN_JOURNAL_FILE_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+/*
+ * Append-only journal file of records: type (1 byte), length of payload (4 bytes), payload.
+ * Appended records are fsynced, a failed append is truncated away again. A record torn by
+ * an interrupted write ends the replay and is dropped from the file.
+ * Not synchronized, the owner serializes the calls.
+ */
+class Journal_file {
+ public:
+  /*
+   * Called per record during replay with the offset of the record in the file,
+   * returning false ends the replay (the record and the rest of the file are dropped)
+   */
+  using Replay = std::function<bool(char type, const char* payload, uint32_t length, uint64_t offset)>;
+
+  explicit Journal_file(const std::string& name) : name(name) {}
+  ~Journal_file();
+
+  static std::string encode_record(char type, const std::string& payload);
+
+  /*
+   * Replays the records of the file at path and opens it for appending,
+   * returns 0 on success, 1 if it can not be opened
+   */
+  int open(const std::string& path, const Replay& replay);
+
+  // Return 0 on success, 1 on failure
+  int append(char type, const std::string& payload);
+  int truncate();
+
+  /*
+   * Replaces the file by one with the given (encoded) records: written to a temporary file
+   * and renamed, until then the old file remains valid. Returns 0 on success, 1 on failure
+   */
+  int rewrite(const std::string& records);
+
+  uint64_t size() const { return file_size; }
+
+ private:
+  std::string name; // for messages, e.g. "commit journal"
+  std::string path;
+  int fd{-1};
+  uint64_t file_size{0};
+};
+
+#endif  // MYSQL_BLOCKCHAIN_JOURNAL_FILE_H
@@ -0,0 +1,46 @@
+#include "tx_arena.h"
+
+#include <algorithm>
+#include <cstdint>
+
+void* Tx_arena::allocate(size_t size, size_t alignment) {
+  auto aligned = [alignment](char* p) {
+    return reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(p) + alignment - 1) & ~(uintptr_t)(alignment - 1));
+  };
+
+  char* p = aligned(pos);
+  if(pos == nullptr || p + size > end) {
+    add_block(size + alignment);
+    p = aligned(pos);
+  }
+
+  pos = p + size;
+  return p;
+}
+
+void Tx_arena::add_block(size_t min_size) {
+  size_t size = blocks.empty() ? TX_ARENA_BLOCK_SIZE : blocks.back().size * 2;
+  size = std::max(size, min_size);
+
+  blocks.push_back(Block{std::unique_ptr<char[]>(new char[size]), size});
+  pos = blocks.back().data.get();
+  end = pos + size;
+}
+
+void Tx_arena::reset() {
+  if(blocks.empty()) {
+    return;
+  }
+
+  // Keep the largest (last) block for the next transaction, unless it is too large
+  Block last = std::move(blocks.back());
+  blocks.clear();
+  if(last.size <= TX_ARENA_MAX_RETAINED) {
+    blocks.push_back(std::move(last));
+    pos = blocks.back().data.get();
+    end = pos + blocks.back().size;
+  } else {
+    pos = nullptr;
+    end = nullptr;
+  }
+}
@@ -0,0 +1,81 @@
+#ifndef MYSQL_BLOCKCHAIN_TX_ARENA_H
+#define MYSQL_BLOCKCHAIN_TX_ARENA_H
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <vector>
+
+#define TX_ARENA_BLOCK_SIZE (64 * 1024)          // size of first block, doubled for each new block
+#define TX_ARENA_MAX_RETAINED (4 * 1024 * 1024)  // max. block size kept by reset()
+
+/*
+ * Bump-pointer arena for the operation payloads of one transaction (see blockchain_table_tx).
+ * Memory is not freed one allocation at a time, but all at once by reset() at the end of the
+ * transaction. The arena is reused by the next transaction of the session.
+ * Not thread safe: allocations happen in the thread of the session only.
+ */
+class Tx_arena {
+ public:
+  void* allocate(size_t size, size_t alignment);
+  void reset();
+
+ private:
+  struct Block {
+    std::unique_ptr<char[]> data;
+    size_t size;
+  };
+
+  std::vector<Block> blocks;
+  char* pos{nullptr};
+  char* end{nullptr};
+
+  void add_block(size_t min_size);
+};
+
+/*
+ * Allocator for containers of the arena, without arena memory is allocated on the heap
+ */
+template <class T>
+class Arena_allocator {
+ public:
+  using value_type = T;
+
+  Arena_allocator() noexcept = default;
+  explicit Arena_allocator(Tx_arena* arena) noexcept : arena(arena) {}
+  template <class U>
+  Arena_allocator(const Arena_allocator<U>& other) noexcept : arena(other.arena) {}
+
+  T* allocate(size_t n) {
+    if(arena == nullptr) {
+      return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+    return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T)));
+  }
+
+  void deallocate(T* p, size_t) noexcept {
+    if(arena == nullptr) {
+      ::operator delete(p);
+    }
+    // arena memory is released with Tx_arena::reset()
+  }
+
+  // copies can outlive the transaction --> allocate them on the heap
+  Arena_allocator select_on_container_copy_construction() const {
+    return Arena_allocator();
+  }
+
+  Tx_arena* arena{nullptr};
+};
+
+template <class T, class U>
+bool operator==(const Arena_allocator<T>& lhs, const Arena_allocator<U>& rhs) {
+  return lhs.arena == rhs.arena;
+}
+
+template <class T, class U>
+bool operator!=(const Arena_allocator<T>& lhs, const Arena_allocator<U>& rhs) {
+  return lhs.arena != rhs.arena;
+}
+
+#endif  // MYSQL_BLOCKCHAIN_TX_ARENA_H
@@ -0,0 +1,197 @@
+#include "tx_cache.h"
+
+#include <algorithm>
+#include <cstring>
+
+#define TX_CACHE_MIN_SLOTS 16
+#define TX_CACHE_NO_SLOT SIZE_MAX // insert_slot: entries or index could not grow
+
+static void pad_key(const uint8_t* key, size_t key_size, uint8_t* padded) {
+  memset(padded, 0, TX_CACHE_SLOT_SIZE);
+  memcpy(padded, key, std::min(key_size, (size_t) TX_CACHE_SLOT_SIZE));
+}
+
+/*
+ * Hashes the padded key word by word (instead of byte by byte)
+ */
+uint32_t Tx_cache::hash_key(const uint8_t* padded_key, uint8_t key_size) {
+  uint64_t h = 0x9e3779b97f4a7c15ULL ^ key_size;
+  for(size_t i = 0; i < TX_CACHE_SLOT_SIZE; i += 8) {
+    uint64_t word;
+    memcpy(&word, padded_key + i, 8);
+    h = (h ^ word) * 0xff51afd7ed558ccdULL;
+    h ^= h >> 32;
+  }
+
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 29;
+  return (uint32_t) h;
+}
+
+/*
+ * Returns the slot of key or the empty slot where it would be inserted
+ */
+size_t Tx_cache::find_slot(const uint8_t* padded_key, uint8_t key_size, uint32_t hash) const {
+  size_t mask = slots.size() - 1;
+  size_t pos = hash & mask;
+
+  while(slots[pos].index != 0) {
+    const Slot& slot = slots[pos];
+    if(slot.hash == hash) {
+      const Entry& entry = entries[slot.index - 1];
+      if(entry.key_size == key_size && memcmp(entry.key, padded_key, TX_CACHE_SLOT_SIZE) == 0) {
+        return pos;
+      }
+    }
+    pos = (pos + 1) & mask;
+  }
+
+  return pos;
+}
+
+const Tx_cache::Entry* Tx_cache::find(const uint8_t* key, size_t key_size) const {
+  if(entries.empty()) {
+    return nullptr;
+  }
+
+  uint8_t padded[TX_CACHE_SLOT_SIZE];
+  pad_key(key, key_size, padded);
+  size_t pos = find_slot(padded, key_size, hash_key(padded, key_size));
+
+  return slots[pos].index == 0 ? nullptr : &entries[slots[pos].index - 1];
+}
+
+/*
+ * Returns the slot of key, which is appended as new entry if it does not exist yet
+ */
+size_t Tx_cache::insert_slot(const uint8_t* key, size_t key_size, bool& found) {
+  found = false;
+  if((entries.size() + 1) * 2 > slots.size() &&
+     !rebuild(std::max(slots.size() * 2, (size_t) TX_CACHE_MIN_SLOTS))) {
+    failed = true;
+    return TX_CACHE_NO_SLOT;
+  }
+
+  Entry entry{};
+  pad_key(key, key_size, entry.key);
+  entry.key_size = key_size;
+
+  uint32_t hash = hash_key(entry.key, entry.key_size);
+  size_t pos = find_slot(entry.key, entry.key_size, hash);
+  found = slots[pos].index != 0;
+
+  if(!found) {
+    if(!entries.push_back(entry)) {
+      failed = true;
+      return TX_CACHE_NO_SLOT;
+    }
+    slots[pos] = Slot{(uint32_t) entries.size(), hash};
+  }
+
+  return pos;
+}
+
+void Tx_cache::put(const uint8_t* key, size_t key_size, const uint8_t* value, size_t value_size) {
+  bool found;
+  size_t pos = insert_slot(key, key_size, found);
+  if(pos == TX_CACHE_NO_SLOT) {
+    return;
+  }
+  Entry& entry = entries[slots[pos].index - 1];
+
+  entry.value_size = std::min(value_size, (size_t) TX_CACHE_SLOT_SIZE);
+  memset(entry.value, 0, TX_CACHE_SLOT_SIZE);
+  memcpy(entry.value, value, entry.value_size);
+}
+
+bool Tx_cache::insert(const uint8_t* key, size_t key_size, const uint8_t* value, size_t value_size) {
+  bool found;
+  size_t pos = insert_slot(key, key_size, found);
+  if(pos == TX_CACHE_NO_SLOT || found) {
+    return false;
+  }
+  Entry& entry = entries[slots[pos].index - 1];
+
+  entry.value_size = std::min(value_size, (size_t) TX_CACHE_SLOT_SIZE);
+  memcpy(entry.value, value, entry.value_size);
+  return true;
+}
+
+void Tx_cache::erase(const uint8_t* key, size_t key_size) {
+  if(entries.empty()) {
+    return;
+  }
+
+  uint8_t padded[TX_CACHE_SLOT_SIZE];
+  pad_key(key, key_size, padded);
+  size_t hole = find_slot(padded, key_size, hash_key(padded, key_size));
+  if(slots[hole].index == 0) {
+    return;
+  }
+  size_t index = slots[hole].index - 1;
+
+  // Backward shift deletion: move following entries of the probe sequence into the hole
+  size_t mask = slots.size() - 1;
+  for(size_t next = (hole + 1) & mask; slots[next].index != 0; next = (next + 1) & mask) {
+    size_t home = slots[next].hash & mask;
+    if(((next - home) & mask) >= ((next - hole) & mask)) {
+      slots[hole] = slots[next];
+      hole = next;
+    }
+  }
+  slots[hole] = Slot{0, 0};
+
+  // Keep entries dense: move last entry into the gap
+  size_t last = entries.size() - 1;
+  if(index != last) {
+    entries[index] = entries[last];
+    size_t pos = hash_key(entries[index].key, entries[index].key_size) & mask;
+    while(slots[pos].index != last + 1) pos = (pos + 1) & mask;
+    slots[pos].index = index + 1;
+  }
+  entries.pop_back();
+}
+
+void Tx_cache::clear() {
+  failed = false;
+  if(entries.empty()) {
+    return;
+  }
+
+  entries.clear();
+  std::fill(slots.begin(), slots.end(), Slot{0, 0});
+}
+
+/*
+ * Only a hint: if it fails, later inserts grow step by step (and fail if still out of memory)
+ */
+void Tx_cache::reserve(size_t count) {
+  if(!entries.reserve(count)) {
+    return;
+  }
+
+  size_t capacity = TX_CACHE_MIN_SLOTS;
+  while(capacity < count * 2) capacity *= 2;
+  if(capacity > slots.size()) {
+    rebuild(capacity);
+  }
+}
+
+/*
+ * Returns false (index unchanged) if the index can not grow
+ */
+bool Tx_cache::rebuild(size_t capacity) {
+  if(!slots.assign(capacity, Slot{0, 0})) {
+    return false;
+  }
+
+  size_t mask = capacity - 1;
+  for(size_t i = 0; i < entries.size(); i++) {
+    uint32_t hash = hash_key(entries[i].key, entries[i].key_size);
+    size_t pos = hash & mask;
+    while(slots[pos].index != 0) pos = (pos + 1) & mask;
+    slots[pos] = Slot{(uint32_t) i + 1, hash};
+  }
+
+  return true;
+}
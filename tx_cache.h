@@ -0,0 +1,74 @@
+#ifndef MYSQL_BLOCKCHAIN_TX_CACHE_H
+#define MYSQL_BLOCKCHAIN_TX_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "tx_spill.h"
+
+#define TX_CACHE_SLOT_SIZE 32 // keys and values are bytes32 in the store contracts
+
+/*
+ * Transaction cache (table scan data) of one table: maps key to value, both stored inline.
+ *
+ * Entries are kept in a dense array, iteration is in insertion order. An erase moves the
+ * last entry into the gap (not done during table scans, see blockchain_table_tx.h).
+ * Lookups use an open-addressing index (linear probing) over the entries.
+ * Entries and index can be moved into a spill file, see spill().
+ * If entries or index can not grow, the change is dropped and out_of_memory() is set until
+ * the next clear().
+ */
+class Tx_cache {
+ public:
+  struct Entry {
+    uint8_t key[TX_CACHE_SLOT_SIZE];   // padded with zeros
+    uint8_t value[TX_CACHE_SLOT_SIZE];
+    uint8_t key_size;
+    uint8_t value_size;
+  };
+
+  const Entry* find(const uint8_t* key, size_t key_size) const;
+
+  /*
+   * Inserts or overwrites the value of key
+   */
+  void put(const uint8_t* key, size_t key_size, const uint8_t* value, size_t value_size);
+
+  /*
+   * Inserts only if key does not exist yet, returns true if inserted
+   */
+  bool insert(const uint8_t* key, size_t key_size, const uint8_t* value, size_t value_size);
+
+  void erase(const uint8_t* key, size_t key_size);
+  void clear();
+  void reserve(size_t count);
+  bool out_of_memory() const { return failed; }
+
+  /*
+   * Moves entries and index into spill files (transaction exceeds bc_tx_memory_budget)
+   */
+  bool spill() { return entries.spill() && slots.spill(); }
+  size_t memory_usage() const { return entries.memory_usage() + slots.memory_usage(); }
+
+  size_t size() const { return entries.size(); }
+  const Entry& at(size_t index) const { return entries[index]; }
+  const Entry* begin() const { return entries.begin(); }
+  const Entry* end() const { return entries.end(); }
+
+ private:
+  struct Slot {
+    uint32_t index; // index of entry + 1, 0: empty
+    uint32_t hash;
+  };
+
+  Spill_vector<Entry> entries;
+  Spill_vector<Slot> slots; // power of two, max. half used
+  bool failed{false};
+
+  static uint32_t hash_key(const uint8_t* padded_key, uint8_t key_size);
+  size_t find_slot(const uint8_t* padded_key, uint8_t key_size, uint32_t hash) const;
+  size_t insert_slot(const uint8_t* key, size_t key_size, bool& found);
+  bool rebuild(size_t capacity);
+};
+
+#endif  // MYSQL_BLOCKCHAIN_TX_CACHE_H
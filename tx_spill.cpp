@@ -0,0 +1,61 @@
+#include "tx_spill.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+std::string Spill_file::directory = "/tmp";
+
+void Spill_file::set_directory(const char* directory) {
+  if(directory != nullptr && *directory != '\0') {
+    Spill_file::directory = directory;
+  }
+}
+
+int Spill_file::create() {
+  std::string path = directory + "/bc_spill_XXXXXX";
+  std::vector<char> name(path.begin(), path.end());
+  name.push_back('\0');
+
+  int fd = mkstemp(name.data());
+  if(fd < 0) {
+    std::cerr << "[BLOCKCHAIN] Cannot create spill file in " << directory << std::endl;
+    return -1;
+  }
+
+  unlink(name.data());
+  return fd;
+}
+
+/*
+ * Grows the file and maps it again, the old mapping is removed (its pages are in the file).
+ * The blocks are allocated here: with a sparse file, a full spill directory would only show
+ * up as SIGBUS on the first write to a page of the mapping.
+ */
+void* Spill_file::resize(int fd, void* mapping, size_t old_size, size_t new_size) {
+  int rc = posix_fallocate(fd, old_size, new_size - old_size);
+  if(rc != 0) {
+    std::cerr << "[BLOCKCHAIN] Cannot grow spill file in " << directory << ": " << strerror(rc) << std::endl;
+    return nullptr;
+  }
+
+  void* p = mmap(nullptr, new_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if(p == MAP_FAILED) {
+    return nullptr;
+  }
+
+  if(mapping != nullptr) {
+    munmap(mapping, old_size);
+  }
+  return p;
+}
+
+void Spill_file::release(int fd, void* mapping, size_t size) {
+  if(mapping != nullptr) {
+    munmap(mapping, size);
+  }
+  close(fd);
+}
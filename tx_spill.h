@@ -0,0 +1,143 @@
+#ifndef MYSQL_BLOCKCHAIN_TX_SPILL_H
+#define MYSQL_BLOCKCHAIN_TX_SPILL_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+#define TX_SPILL_MIN_CAPACITY 16
+
+/*
+ * Temporary files for transaction state that exceeds bc_tx_memory_budget. The files are
+ * removed from the directory right after creation, so they disappear with the process.
+ */
+class Spill_file {
+ public:
+  static void set_directory(const char* directory); // default: /tmp
+
+  static int create(); // file descriptor, -1 on error
+  static void* resize(int fd, void* mapping, size_t old_size, size_t new_size); // nullptr on error (e.g. disk full)
+  static void release(int fd, void* mapping, size_t size);
+
+ private:
+  static std::string directory;
+};
+
+/*
+ * Array of trivially copyable items, in memory until spill() moves it into a memory mapped
+ * spill file. Afterwards the pages are backed by the file instead of swap, the kernel writes
+ * them back and drops them under memory pressure (and reads them again on access).
+ * Like std::vector, growing invalidates pointers to items. If the array can not grow (out of
+ * memory, spill file can not be extended), push_back, reserve and assign return false and
+ * leave the items unchanged.
+ */
+template <class T>
+class Spill_vector {
+  static_assert(std::is_trivially_copyable<T>::value, "items are copied bytewise");
+
+ public:
+  Spill_vector() = default;
+  Spill_vector(const Spill_vector&) = delete;
+  Spill_vector& operator=(const Spill_vector&) = delete;
+  ~Spill_vector() { release(); }
+
+  size_t size() const { return count; }
+  bool empty() const { return count == 0; }
+  T& operator[](size_t index) { return items[index]; }
+  const T& operator[](size_t index) const { return items[index]; }
+  T* begin() { return items; }
+  T* end() { return items + count; }
+  const T* begin() const { return items; }
+  const T* end() const { return items + count; }
+
+  bool push_back(const T& item) {
+    if(count == capacity && !grow(std::max(capacity * 2, (size_t) TX_SPILL_MIN_CAPACITY))) {
+      return false;
+    }
+    items[count++] = item;
+    return true;
+  }
+
+  void pop_back() { count--; }
+  void clear() { count = 0; }
+
+  bool reserve(size_t min_capacity) {
+    return min_capacity <= capacity || grow(min_capacity);
+  }
+
+  bool assign(size_t size, const T& item) {
+    if(!reserve(size)) {
+      return false;
+    }
+    std::fill(items, items + size, item);
+    count = size;
+    return true;
+  }
+
+  bool is_spilled() const { return fd >= 0; }
+
+  // Bytes held in memory (not backed by a spill file)
+  size_t memory_usage() const { return is_spilled() ? 0 : capacity * sizeof(T); }
+
+  /*
+   * Moves the items into a new spill file, returns false (and stays in memory) on error
+   */
+  bool spill() {
+    if(is_spilled()) {
+      return true;
+    }
+
+    int file = Spill_file::create();
+    if(file < 0) {
+      return false;
+    }
+
+    size_t size = std::max(capacity, (size_t) TX_SPILL_MIN_CAPACITY);
+    void* mapping = Spill_file::resize(file, nullptr, 0, size * sizeof(T));
+    if(mapping == nullptr) {
+      Spill_file::release(file, nullptr, 0);
+      return false;
+    }
+
+    if(count > 0) {
+      memcpy(mapping, items, count * sizeof(T));
+    }
+    std::free(items);
+
+    fd = file;
+    items = static_cast<T*>(mapping);
+    capacity = size;
+    return true;
+  }
+
+ private:
+  T* items{nullptr};
+  size_t count{0};
+  size_t capacity{0};
+  int fd{-1}; // spill file, -1: in memory
+
+  bool grow(size_t new_capacity) {
+    void* p = is_spilled() ? Spill_file::resize(fd, items, capacity * sizeof(T), new_capacity * sizeof(T))
+                           : std::realloc(items, new_capacity * sizeof(T));
+    if(p == nullptr) {
+      return false; // old items are still valid
+    }
+
+    items = static_cast<T*>(p);
+    capacity = new_capacity;
+    return true;
+  }
+
+  void release() {
+    if(is_spilled()) {
+      Spill_file::release(fd, items, capacity * sizeof(T));
+    } else {
+      std::free(items);
+    }
+  }
+};
+
+#endif  // MYSQL_BLOCKCHAIN_TX_SPILL_H
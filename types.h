@@ -22,6 +22,9 @@
 #include <boost/uuid/uuid.hpp>
 #include <boost/uuid/uuid_generators.hpp>
 
+#include "tx_arena.h"
+#include "tx_cache.h"
+
 using Table_name = std::string;
 using byte = unsigned char;
 using TXID = boost::uuids::uuid;
@@ -33,7 +36,28 @@ enum BC_TYPE {
   ETHEREUM = 0
 };
 
+enum STORE_LAYOUT {
+  STORE_LAYOUT_V1 = 0, // KVStore (TableStorage.sol)
+  STORE_LAYOUT_V2 = 1, // KVStoreV2 (TableStorageV2.sol)
+  STORE_LAYOUT_MULTI = 2, // KVStoreMulti (TableStorageMulti.sol), many tables in one contract
+  STORE_LAYOUT_LOG = 3, // KVLog (LogStorage.sol), operations only in event logs
+  STORE_LAYOUT_ROLLUP = 4 // KVRollup (RollupStorage.sol), rows in local journal, Merkle roots of batches on chain
+};
+
+/*
+ * Store contract of a table, configured as tableName:address[:v2|:log|:rollup], tableName:address:log:block
+ * (deployment block of the contract) or tableName:address:multi:tableId
+ */
+class Table_contract {
+ public:
+  std::string address;
+  int layout{STORE_LAYOUT_V1};
+  uint32_t table_id{0}; // namespace of table in a multi-table store contract
+  uint64_t first_block{0}; // log store: block the contract was deployed in, 0: looked up
+};
+
 typedef struct bc_ha_data_table_t {
+  std::unique_ptr<Tx_arena> arena; // reused by the next transaction, declared before tx (which returns it)
   std::unique_ptr<blockchain_table_tx> tx;
   Connector* connector;
 } bc_ha_data_table_t;
@@ -52,6 +76,8 @@ class Byte_data {
   uint8_t data_size;
 };
 
+using Byte_vector = std::vector<byte, Arena_allocator<byte>>;
+
 /*
  * Should be used if data was allocated by storage engine (and not by MySQL core)
  * --> frees the data!
@@ -59,23 +85,26 @@ class Byte_data {
 class Managed_byte_data {
  public:
   Managed_byte_data() = default;
-  explicit Managed_byte_data(std::shared_ptr<std::vector<byte>>& p_data) {
+  explicit Managed_byte_data(std::shared_ptr<Byte_vector>& p_data) {
     data = p_data;
   }
   explicit Managed_byte_data(size_t size) {
-    data = std::make_shared<std::vector<byte>>(size);
+    data = std::make_shared<Byte_vector>(size);
+  }
+  // data (and shared_ptr control block) in arena of a transaction, must not outlive it
+  Managed_byte_data(size_t size, Tx_arena* arena) {
+    data = std::allocate_shared<Byte_vector>(Arena_allocator<Byte_vector>(arena), size, Arena_allocator<byte>(arena));
   }
 
-  std::shared_ptr<std::vector<byte>> data;
+  std::shared_ptr<Byte_vector> data;
 };
 
 inline bool operator==(const Managed_byte_data& lhs, const Managed_byte_data& rhs) {
   return *(lhs.data.get()) == *(rhs.data.get());
 }
 
-// todo: evaluate use of another data structure (like <tsl/hopscotch_map.h>)
 // requirements: allows random access and access by key
-using tx_cache_t = std::unordered_map<Managed_byte_data, Managed_byte_data>;
+using tx_cache_t = Tx_cache;
 
 // Define hash function for ManagedByteData
 namespace std {
@@ -84,7 +113,7 @@ namespace std {
   {
     std::size_t operator()(const Managed_byte_data& k) const
     {
-      return boost::hash<std::vector<unsigned char>>()(*(k.data.get()));
+      return boost::hash_range(k.data->begin(), k.data->end());
     }
   };
 }
@@ -103,4 +132,14 @@ class Remove_op {
   Managed_byte_data key;
 };
 
+/*
+ * Put or remove operation, used where puts and removes are kept in one ordered list
+ */
+class Batch_op {
+ public:
+  Managed_byte_data key;
+  Managed_byte_data value; // empty for remove operations
+  bool remove{false};
+};
+
 #endif  // MYSQL_HABC_TYPES_H
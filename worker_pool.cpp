@@ -0,0 +1,75 @@
+#include "worker_pool.h"
+
+size_t Worker_pool::worker_count = 16;
+
+void Worker_pool::set_worker_count(size_t count) {
+  worker_count = count;
+}
+
+Worker_pool& Worker_pool::get() {
+  static Worker_pool pool(worker_count);
+  return pool;
+}
+
+Worker_pool::Worker_pool(size_t count) {
+  max_queued = count * WORKER_POOL_QUEUE_PER_WORKER;
+  for(size_t i = 0; i < count; i++) {
+    workers.emplace_back(&Worker_pool::work, this);
+  }
+}
+
+Worker_pool::~Worker_pool() {
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    stopping = true;
+  }
+  task_available.notify_all();
+
+  for(auto& worker : workers) {
+    if(worker.joinable()) worker.join();
+  }
+}
+
+void Worker_pool::submit(Task_group& group, std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> lock(group.mtx);
+    group.pending++;
+  }
+
+  std::unique_lock<std::mutex> lock(mtx);
+  space_available.wait(lock, [this] { return tasks.size() < max_queued; });
+  tasks.push(Task{&group, std::move(task)});
+  lock.unlock();
+
+  task_available.notify_one();
+}
+
+void Worker_pool::work() {
+  while(true) {
+    Task task;
+    {
+      std::unique_lock<std::mutex> lock(mtx);
+      task_available.wait(lock, [this] { return stopping || !tasks.empty(); });
+      if(tasks.empty()) {
+        return; // stopping
+      }
+
+      task = std::move(tasks.front());
+      tasks.pop();
+    }
+    space_available.notify_one();
+
+    task.run();
+    task.run = nullptr; // release captured data before the group is done (it may be freed then)
+
+    std::lock_guard<std::mutex> lock(task.group->mtx);
+    if(--task.group->pending == 0) {
+      task.group->all_done.notify_all();
+    }
+  }
+}
+
+void Worker_pool::Task_group::wait() {
+  std::unique_lock<std::mutex> lock(mtx);
+  all_done.wait(lock, [this] { return pending == 0; });
+}
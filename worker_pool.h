@@ -0,0 +1,62 @@
+#ifndef MYSQL_BLOCKCHAIN_WORKER_POOL_H
+#define MYSQL_BLOCKCHAIN_WORKER_POOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#define WORKER_POOL_QUEUE_PER_WORKER 32 // max. queued tasks per worker, submit blocks if more
+
+/*
+ * Engine-wide pool of worker threads for sending operations to the blockchain
+ * (bc_tx_prepare_immediately). The queue is bounded: submit() blocks while it is full,
+ * so large transactions are slowed down instead of creating unbounded work.
+ */
+class Worker_pool {
+ public:
+  /*
+   * Tasks of one transaction, wait() returns when all of them are done
+   */
+  class Task_group {
+   public:
+    void wait();
+
+   private:
+    friend class Worker_pool;
+    std::mutex mtx;
+    std::condition_variable all_done;
+    size_t pending{0};
+  };
+
+  static Worker_pool& get();
+  static void set_worker_count(size_t count); // before first use of get()
+
+  void submit(Task_group& group, std::function<void()> task);
+
+  ~Worker_pool();
+
+ private:
+  struct Task {
+    Task_group* group;
+    std::function<void()> run;
+  };
+
+  static size_t worker_count;
+
+  std::vector<std::thread> workers;
+  std::queue<Task> tasks;
+  std::mutex mtx;
+  std::condition_variable task_available;
+  std::condition_variable space_available;
+  size_t max_queued;
+  bool stopping{false};
+
+  explicit Worker_pool(size_t count);
+  void work();
+};
+
+#endif  // MYSQL_BLOCKCHAIN_WORKER_POOL_H